@@ -18,6 +18,9 @@ typedef struct BLOOMFILTER {
     
     // We store the number of blocks we add to each filter in count_added_blocks
     short int amount_of_blocks;
+
+    // Cached popcount of array, kept up to date while hashing and after reading a filter
+    unsigned short bits_set;
     
     // Pointer to next Bloomfilter
     struct BLOOMFILTER *next;
@@ -32,6 +35,7 @@ void            destroy_bf(BLOOMFILTER *bf);
 void            bloom_set_bit(unsigned char *bit_array, unsigned short value);
 unsigned short  count_bits_set_to_one_of_BF(unsigned char *filter);
 unsigned short  bloom_common_bits(unsigned char *bit_array_one, unsigned char *bit_array_two);
+void            update_bits_set_of_BF(BLOOMFILTER *bf);
 
 void            add_hash_to_bloomfilter(BLOOMFILTER *bf, uint64 hash_value);
 void            convert_hex_binary(const unsigned char *hex_string, BLOOMFILTER *bf);
@@ -42,6 +42,9 @@ int                 fingerprint_compare(FINGERPRINT *fingerprint1, FINGERPRINT *
 int                 bloom_max_score(BLOOMFILTER *bf, FINGERPRINT *fingerprint);
 void                add_hash_to_fingerprint(FINGERPRINT *fp, uint64 hash_value);
 double              compute_e_min(int blocks_in_bf1, int blocks_in_bf2);
+void                init_score_tables();
+int                 lookup_e_min(int blocks_in_bf1, int blocks_in_bf2);
+int                 compute_cut_off(int e_min, int e_max);
 
 //unsigned int        read_input_hash_file(FINGERPRINT_LIST *fpl,FILE *handle);
 
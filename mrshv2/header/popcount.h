@@ -0,0 +1,27 @@
+/*
+ * File:   popcount.h
+ *
+ * Fused AND + popcount kernels over a single Bloom filter (FILTERSIZE bytes).
+ * The fastest kernel supported by the CPU is selected once at load time.
+ */
+
+#ifndef POPCOUNT_H
+#define	POPCOUNT_H
+
+//amount of filters the group kernel compares against one filter
+#define AND_POPCOUNT_GROUP 4
+
+typedef unsigned short (*AND_POPCOUNT_KERNEL)(const unsigned char *filter_one, const unsigned char *filter_two);
+typedef void (*AND_POPCOUNT_GROUP_KERNEL)(const unsigned char *filter, const unsigned char *const *group, unsigned short *counts);
+
+//popcount(filter_one & filter_two), points to the selected kernel
+extern AND_POPCOUNT_KERNEL and_popcount;
+
+//counts[i] = popcount(filter & group[i]) for AND_POPCOUNT_GROUP filters, the filter is loaded once per word
+extern AND_POPCOUNT_GROUP_KERNEL and_popcount_group;
+
+void            select_and_popcount_kernel();
+const char      *and_popcount_kernel_name();
+
+
+#endif	/* POPCOUNT_H */
@@ -12,6 +12,7 @@
 #include "base64/modp_b64.h"
 #include "../header/hashing.h"
 #include "../header/bloomfilter.h"
+#include "../header/popcount.h"
 #include "../header/util.h"
 
 
@@ -65,40 +66,35 @@ void add_hash_to_bloomfilter(BLOOMFILTER *bf, uint64 hash_value){
 	//in worst case it is an attack
 	if(one_counter != SUBHASHES)
 		bf->amount_of_blocks++;
+
+	//every sub-hash that did not hit a one set a new bit
+	bf->bits_set += SUBHASHES - one_counter;
 }
 
 
 /*
- * computes the hamming weight (bits set to one) within an integer.
+ * computes the hamming weight (bits set to one) of a Bloom filter.
  * one should pass a unsigned char *array
  */
 unsigned short count_bits_set_to_one_of_BF(unsigned char filter[]) {
-    unsigned short  counted_bits=0;
-    int a,v;
-    int *tmp = filter;
-
-    for(a=0;a<FILTERSIZE/4;a++){
-    	v = tmp[a];
-    	v = v - ((v >> 1) & 0x55555555);                //put count of each 2 bits into those 2 bits
-    	v = (v & 0x33333333) + ((v >> 2) & 0x33333333); //put count of each 4 bits into those 4 bits
-    	counted_bits += ((v + (v >> 4) & 0xF0F0F0F) * 0x1010101) >> 24;
-    }
-    return counted_bits;
+    return and_popcount(filter, filter);
 }
 
 
-
-
-
-
-
+/*
+ * computes the bits set in both filters, the AND and the popcount are fused
+ * in the kernel selected at load time (see popcount.c)
+ */
 unsigned short bloom_common_bits(unsigned char bit_array_one[], unsigned char bit_array_two[]) {
-    unsigned char buffer[FILTERSIZE]={0};
-    int a;
-    for(a=0;a<FILTERSIZE;a++)
-        buffer[a] = bit_array_one[a] & bit_array_two[a];
+    return and_popcount(bit_array_one, bit_array_two);
+}
 
-    return count_bits_set_to_one_of_BF(buffer);
+
+/*
+ * recomputes the cached popcount, needed whenever the array was filled directly
+ */
+void update_bits_set_of_BF(BLOOMFILTER *bf) {
+    bf->bits_set = count_bits_set_to_one_of_BF(bf->array);
 }
 
 
@@ -119,6 +115,7 @@ void convert_hex_binary(const unsigned char *hex_string, BLOOMFILTER *bf)
 	  	  sscanf(hex_string, "%2hhx", &bf->array[i]);
 	  	  hex_string += 2 * sizeof(char);
 	}
+	update_bits_set_of_BF(bf);
 }
 
 
@@ -4,6 +4,8 @@
  * Email: Frank.Breitinger@cased.de
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
 #include "../header/config.h"
 #include "../header/fingerprint.h"
 #include "../header/helper.h"
@@ -161,12 +163,12 @@ int bloom_max_score(BLOOMFILTER *bf, FINGERPRINT *fingerprint) {
     int tmp_score = 0;
     int score     = 0;
 
-    int bitsSetOfBF1 = count_bits_set_to_one_of_BF(bf->array);
+    int bitsSetOfBF1 = bf->bits_set;
 
 
     BLOOMFILTER *tmp_bf = fingerprint->bf_list;
 
-    e_min = compute_e_min(bf->amount_of_blocks, tmp_bf->amount_of_blocks);
+    e_min = lookup_e_min(bf->amount_of_blocks, tmp_bf->amount_of_blocks);
 
     for(i=0;i<=fingerprint->amount_of_BF;i++) {
 
@@ -178,11 +180,11 @@ int bloom_max_score(BLOOMFILTER *bf, FINGERPRINT *fingerprint) {
 
     	//for the last Bloom filter we have to update the values
        	if(tmp_bf->next == NULL) {
-           	e_min = compute_e_min(tmp_bf->amount_of_blocks, bf->amount_of_blocks);
+           	e_min = lookup_e_min(tmp_bf->amount_of_blocks, bf->amount_of_blocks);
         }
 
-       	e_max = MIN(bitsSetOfBF1, count_bits_set_to_one_of_BF(tmp_bf->array));
-   	    C = 0.3*(e_max - e_min)+e_min;
+       	e_max = MIN(bitsSetOfBF1, tmp_bf->bits_set);
+   	    C = compute_cut_off(e_min, e_max);
 
 
 
@@ -190,9 +192,6 @@ int bloom_max_score(BLOOMFILTER *bf, FINGERPRINT *fingerprint) {
        	//compute bits in common
         unsigned int numofbitsInCommon = bloom_common_bits(tmp_bf->array, bf->array);
 
-      	 if(numofbitsInCommon > C)
-      		 printf("");
-
         //if they are high enough we have a threshold
         if(numofbitsInCommon < C) {
             tmp_score = 0;
@@ -226,6 +225,59 @@ double compute_e_min(int blocks_in_bf1, int blocks_in_bf2){
 }
 
 
+//e_min (truncated like in the original int assignment) for every pair of block counts
+static short e_min_table[MAXBLOCKS+1][MAXBLOCKS+1];
+static int   e_min_table_max = -1;
+
+//true if C = 0.3*(e_max-e_min)+e_min equals (7*e_min+3*e_max)/10 for every e_min in the table
+static bool  integer_cut_off = false;
+
+
+/*
+ * Fills the e_min table and verifies the integer cut-off once at load time,
+ * so the scoring loop does no floating point work for regular filters
+ */
+__attribute__((constructor))
+void init_score_tables(){
+	int b1, b2, e_min, e_max;
+
+	for(b1=0;b1<=MAXBLOCKS;b1++) {
+		for(b2=0;b2<=MAXBLOCKS;b2++) {
+			e_min = compute_e_min(b1, b2);
+			e_min_table[b1][b2] = e_min;
+			e_min_table_max = MAX(e_min_table_max, e_min);
+		}
+	}
+
+	integer_cut_off = true;
+	for(e_min=0;e_min<=e_min_table_max && integer_cut_off;e_min++) {
+		for(e_max=0;e_max<=BLOOMFILTERBITSIZE;e_max++) {
+			int C = 0.3*(e_max - e_min)+e_min;
+			if(C != (7*e_min + 3*e_max)/10) {
+				integer_cut_off = false;
+				break;
+			}
+		}
+	}
+}
+
+
+//table lookup, block counts outside of [0, MAXBLOCKS] (e.g. from a broken hash file) are computed
+int lookup_e_min(int blocks_in_bf1, int blocks_in_bf2){
+	if(e_min_table_max >= 0 && blocks_in_bf1 >= 0 && blocks_in_bf1 <= MAXBLOCKS && blocks_in_bf2 >= 0 && blocks_in_bf2 <= MAXBLOCKS)
+		return e_min_table[blocks_in_bf1][blocks_in_bf2];
+	return compute_e_min(blocks_in_bf1, blocks_in_bf2);
+}
+
+
+//the threshold C of bits in common a filter pair needs for a score above 0
+int compute_cut_off(int e_min, int e_max){
+	if(integer_cut_off && e_min >= 0 && e_min <= e_min_table_max && e_max >= 0 && e_max <= BLOOMFILTERBITSIZE)
+		return (7*e_min + 3*e_max)/10;
+	return 0.3*(e_max - e_min)+e_min;
+}
+
+
 
 void print_fingerprint(FINGERPRINT *fp){
     int j;
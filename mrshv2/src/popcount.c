@@ -0,0 +1,239 @@
+/**
+ * Fused AND + popcount kernels for the Bloom filter comparison.
+ *
+ * Every kernel returns popcount(filter_one & filter_two) over FILTERSIZE bytes,
+ * so all of them give exactly the same result. The group kernels do the same
+ * for one filter against AND_POPCOUNT_GROUP others, each word of the first
+ * filter is loaded once and the counts are kept in registers. The kernel is picked once via
+ * CPUID when the library is loaded, the portable SWAR kernel is the fallback.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "../header/config.h"
+#include "../header/popcount.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && (__GNUC__ >= 7 || defined(__clang__))
+#define X86_KERNELS
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if FILTERSIZE % 64 != 0
+#error "the popcount kernels expect FILTERSIZE to be a multiple of 64 bytes"
+#endif
+
+
+
+//portable 64 bit SWAR popcount, no stack copy of the AND
+static unsigned short and_popcount_scalar(const unsigned char *filter_one, const unsigned char *filter_two){
+	unsigned short counted_bits = 0;
+	uint64_t x, y, v;
+
+	for(int i=0;i<FILTERSIZE;i+=8){
+		memcpy(&x, filter_one+i, 8);
+		memcpy(&y, filter_two+i, 8);
+		v = x & y;
+		v = v - ((v >> 1) & 0x5555555555555555ULL);                         //put count of each 2 bits into those 2 bits
+		v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL); //put count of each 4 bits into those 4 bits
+		v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;                          //put count of each 8 bits into those 8 bits
+		counted_bits += (v * 0x0101010101010101ULL) >> 56;
+	}
+	return counted_bits;
+}
+
+
+static void and_popcount_group_scalar(const unsigned char *filter, const unsigned char *const *group, unsigned short *counts){
+	for(int g=0;g<AND_POPCOUNT_GROUP;g++)
+		counts[g] = and_popcount_scalar(filter, group[g]);
+}
+
+
+#ifdef X86_KERNELS
+
+//SSE4.2 era popcnt instruction on 64 bit words
+__attribute__((target("popcnt")))
+static unsigned short and_popcount_popcnt(const unsigned char *filter_one, const unsigned char *filter_two){
+	unsigned short counted_bits = 0;
+	uint64_t x, y;
+
+	for(int i=0;i<FILTERSIZE;i+=8){
+		memcpy(&x, filter_one+i, 8);
+		memcpy(&y, filter_two+i, 8);
+		counted_bits += __builtin_popcountll(x & y);
+	}
+	return counted_bits;
+}
+
+
+__attribute__((target("popcnt")))
+static void and_popcount_group_popcnt(const unsigned char *filter, const unsigned char *const *group, unsigned short *counts){
+	unsigned short counted_bits[AND_POPCOUNT_GROUP] = {0};
+	uint64_t x, y;
+
+	for(int i=0;i<FILTERSIZE;i+=8){
+		memcpy(&x, filter+i, 8);
+		for(int g=0;g<AND_POPCOUNT_GROUP;g++){
+			memcpy(&y, group[g]+i, 8);
+			counted_bits[g] += __builtin_popcountll(x & y);
+		}
+	}
+	for(int g=0;g<AND_POPCOUNT_GROUP;g++)
+		counts[g] = counted_bits[g];
+}
+
+
+//AVX2 nibble lookup (vpshufb), byte counts are summed once with vpsadbw at the end
+//a byte can count at most 8 bits per 32 byte step, so FILTERSIZE/32 steps stay below 256
+__attribute__((target("avx2")))
+static unsigned short and_popcount_avx2(const unsigned char *filter_one, const unsigned char *filter_two){
+	const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+	                                        0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i byte_counts = _mm256_setzero_si256();
+
+	for(int i=0;i<FILTERSIZE;i+=32){
+		__m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(filter_one+i)),
+		                             _mm256_loadu_si256((const __m256i *)(filter_two+i)));
+		__m256i lo = _mm256_and_si256(v, low_mask);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+		byte_counts = _mm256_add_epi8(byte_counts, _mm256_shuffle_epi8(lookup, lo));
+		byte_counts = _mm256_add_epi8(byte_counts, _mm256_shuffle_epi8(lookup, hi));
+	}
+
+	__m256i sums = _mm256_sad_epu8(byte_counts, _mm256_setzero_si256());
+	return _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+	     + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+}
+
+
+__attribute__((target("avx2")))
+static void and_popcount_group_avx2(const unsigned char *filter, const unsigned char *const *group, unsigned short *counts){
+	const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+	                                        0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i byte_counts[AND_POPCOUNT_GROUP];
+
+	for(int g=0;g<AND_POPCOUNT_GROUP;g++)
+		byte_counts[g] = _mm256_setzero_si256();
+
+	for(int i=0;i<FILTERSIZE;i+=32){
+		__m256i f = _mm256_loadu_si256((const __m256i *)(filter+i));
+		for(int g=0;g<AND_POPCOUNT_GROUP;g++){
+			__m256i v = _mm256_and_si256(f, _mm256_loadu_si256((const __m256i *)(group[g]+i)));
+			__m256i lo = _mm256_and_si256(v, low_mask);
+			__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+			byte_counts[g] = _mm256_add_epi8(byte_counts[g], _mm256_shuffle_epi8(lookup, lo));
+			byte_counts[g] = _mm256_add_epi8(byte_counts[g], _mm256_shuffle_epi8(lookup, hi));
+		}
+	}
+
+	for(int g=0;g<AND_POPCOUNT_GROUP;g++){
+		__m256i sums = _mm256_sad_epu8(byte_counts[g], _mm256_setzero_si256());
+		counts[g] = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+		          + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+	}
+}
+
+
+//AVX-512 VPOPCNTDQ, four 64 byte lanes per filter
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static unsigned short and_popcount_avx512(const unsigned char *filter_one, const unsigned char *filter_two){
+	__m512i counts = _mm512_setzero_si512();
+
+	for(int i=0;i<FILTERSIZE;i+=64){
+		__m512i v = _mm512_and_si512(_mm512_loadu_si512((const void *)(filter_one+i)),
+		                             _mm512_loadu_si512((const void *)(filter_two+i)));
+		counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(v));
+	}
+	return _mm512_reduce_add_epi64(counts);
+}
+
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void and_popcount_group_avx512(const unsigned char *filter, const unsigned char *const *group, unsigned short *counts){
+	__m512i group_counts[AND_POPCOUNT_GROUP];
+
+	for(int g=0;g<AND_POPCOUNT_GROUP;g++)
+		group_counts[g] = _mm512_setzero_si512();
+
+	for(int i=0;i<FILTERSIZE;i+=64){
+		__m512i f = _mm512_loadu_si512((const void *)(filter+i));
+		for(int g=0;g<AND_POPCOUNT_GROUP;g++){
+			__m512i v = _mm512_and_si512(f, _mm512_loadu_si512((const void *)(group[g]+i)));
+			group_counts[g] = _mm512_add_epi64(group_counts[g], _mm512_popcnt_epi64(v));
+		}
+	}
+
+	for(int g=0;g<AND_POPCOUNT_GROUP;g++)
+		counts[g] = _mm512_reduce_add_epi64(group_counts[g]);
+}
+
+
+//extended control register, tells which register states the OS saves
+static uint64_t read_xcr0(){
+	uint32_t lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+#endif
+
+
+
+AND_POPCOUNT_KERNEL and_popcount = and_popcount_scalar;
+AND_POPCOUNT_GROUP_KERNEL and_popcount_group = and_popcount_group_scalar;
+static const char *kernel_name = "scalar";
+
+
+/*
+ * Picks the fastest kernel via CPUID. Runs once when the library is loaded,
+ * calling it again is harmless.
+ */
+__attribute__((constructor))
+void select_and_popcount_kernel(){
+	and_popcount = and_popcount_scalar;
+	and_popcount_group = and_popcount_group_scalar;
+	kernel_name = "scalar";
+
+#ifdef X86_KERNELS
+	unsigned int eax, ebx, ecx, edx;
+	uint64_t xcr0 = 0;
+
+	if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return;
+
+	if(ecx & bit_POPCNT) {
+		and_popcount = and_popcount_popcnt;
+		and_popcount_group = and_popcount_group_popcnt;
+		kernel_name = "popcnt";
+	}
+
+	//AVX state has to be enabled by the OS (OSXSAVE + XCR0) before ymm/zmm registers can be used
+	if(!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+		return;
+	xcr0 = read_xcr0();
+	if((xcr0 & 0x06) != 0x06)
+		return;
+
+	if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return;
+
+	if(ebx & (1 << 5)) {                            //AVX2
+		and_popcount = and_popcount_avx2;
+		and_popcount_group = and_popcount_group_avx2;
+		kernel_name = "avx2";
+	}
+
+	//AVX512F + VPOPCNTDQ, opmask and upper zmm state enabled
+	if((ebx & (1 << 16)) && (ecx & (1 << 14)) && (xcr0 & 0xe6) == 0xe6) {
+		and_popcount = and_popcount_avx512;
+		and_popcount_group = and_popcount_group_avx512;
+		kernel_name = "avx512-vpopcntdq";
+	}
+#endif
+}
+
+
+const char *and_popcount_kernel_name(){
+	return kernel_name;
+}
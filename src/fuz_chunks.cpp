@@ -0,0 +1,84 @@
+/**
+ *
+ * fuz_chunks:
+ *
+ * Raw mrshv2 chunk hashes and an inverted index over them
+ */
+
+#include <algorithm>
+
+#include "fuz_chunks.h"
+
+// mrshv2
+extern "C" {
+#include "mrshv2/header/config.h"
+#include "mrshv2/header/hashing.h"
+#include "mrshv2/header/util.h"
+}
+
+void fuz_chunk_hashes(const unsigned char *packet, size_t length, std::vector<uint64_t> &hashes)
+{
+    unsigned int last_block_index = 0;
+    uchar window[ROLLING_WINDOW] = {0};
+    uint32 rhData[4] = {0};
+
+    // same chunk boundaries as hashPacketBuffer without the network define
+    for (unsigned int i = 0; i < length; i++) {
+        uint64 rValue = roll_hashx(packet[i], window, rhData);
+
+        if (rValue % BLOCK_SIZE == BLOCK_SIZE-1) {
+            hashes.push_back(fnv64Bit((unsigned char *)packet, last_block_index, i));
+            last_block_index = i+1;
+
+            if (i+SKIPPED_BYTES < length)
+                i += SKIPPED_BYTES;
+        }
+    }
+    hashes.push_back(fnv64Bit((unsigned char *)packet, last_block_index, length-1));
+}
+
+void fuz_chunk_distinct(std::vector<uint64_t> &hashes)
+{
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+}
+
+int fuz_chunk_score(uint32_t shared, uint32_t chunks1, uint32_t chunks2)
+{
+    const uint32_t smaller = std::min(chunks1, chunks2);
+    if (smaller < MINBLOCKS) return 0;
+    return 100 * shared / smaller;
+}
+
+fuz_chunk_index::fuz_chunk_index()
+    : names(), chunks(), table()
+{
+}
+
+void fuz_chunk_index::add(const std::string &name, std::vector<uint64_t> hashes)
+{
+    const uint32_t ref = names.size();
+    fuz_chunk_distinct(hashes);
+
+    names.push_back(name);
+    chunks.push_back(hashes.size());
+    for (uint64_t hash : hashes) table.add(hash, ref);
+}
+
+void fuz_chunk_index::finalize()
+{
+    table.finalize();
+}
+
+void fuz_chunk_index::shared(const std::vector<uint64_t> &distinct, std::vector<std::pair<uint32_t, uint32_t> > &counts) const
+{
+    std::vector<uint32_t> hits;
+    for (uint64_t hash : distinct) table.lookup(hash, hits);
+    std::sort(hits.begin(), hits.end());
+
+    counts.clear();
+    for (uint32_t ref : hits) {
+        if (counts.empty() || counts.back().first != ref) counts.push_back(std::make_pair(ref, 0));
+        counts.back().second++;
+    }
+}
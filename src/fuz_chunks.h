@@ -0,0 +1,56 @@
+/**
+ *
+ * fuz_chunks:
+ *
+ * Raw mrshv2 chunk hashes and an inverted index over them
+ */
+
+#ifndef FUZ_CHUNKS_H
+#define FUZ_CHUNKS_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fuz_index.h"
+
+// block with the hashes of its chunks in input order
+struct fuz_chunk_block {
+    fuz_chunk_block() : name(), hashes() {}
+
+    std::string name;
+    std::vector<uint64_t> hashes;
+};
+
+// mrshv2s hashPacketBuffer without the bloom filters: appends the FNV hash of every chunk of the buffer
+void fuz_chunk_hashes(const unsigned char *packet, size_t length, std::vector<uint64_t> &hashes);
+
+// sorts the hashes and removes duplicates
+void fuz_chunk_distinct(std::vector<uint64_t> &hashes);
+
+// score of two blocks from their distinct chunks, relative to the block with fewer chunks like mrshv2,
+// blocks with less than MINBLOCKS chunks score 0 like filters with less than MINBLOCKS blocks
+int fuz_chunk_score(uint32_t shared, uint32_t chunks1, uint32_t chunks2);
+
+// inverted index from chunk hash to the imported blocks that contain it
+struct fuz_chunk_index {
+    fuz_chunk_index();
+
+    void add(const std::string &name, std::vector<uint64_t> hashes);
+    // builds the lookup table, has to be called before shared
+    void finalize();
+    // (ref, chunks in common) of every imported block sharing a chunk with the distinct hashes, sorted by ref
+    void shared(const std::vector<uint64_t> &distinct, std::vector<std::pair<uint32_t, uint32_t> > &counts) const;
+
+    size_t size() const { return names.size(); }
+
+    // per imported block
+    std::vector<std::string> names;
+    std::vector<uint32_t> chunks;
+
+private:
+    fuz_key_table table;
+};
+
+#endif
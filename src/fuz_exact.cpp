@@ -0,0 +1,143 @@
+/**
+ *
+ * fuz_exact:
+ *
+ * 128-bit block digests for byte-identical blocks
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "fuz_exact.h"
+
+static inline uint64_t fuz_rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fuz_fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// MurmurHash3_x64_128 by Austin Appleby (public domain) with seed 0
+fuz_digest128 fuz_exact_digest(const uint8_t *buf, size_t length)
+{
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    const size_t nblocks = length / 16;
+    uint64_t h1 = 0, h2 = 0;
+
+    for (size_t i = 0; i < nblocks; i++) {
+        uint64_t k1, k2;
+        memcpy(&k1, buf + i*16, sizeof(k1));
+        memcpy(&k2, buf + i*16 + 8, sizeof(k2));
+
+        k1 *= c1; k1 = fuz_rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = fuz_rotl64(h1, 27); h1 += h2; h1 = h1*5 + 0x52dce729;
+        k2 *= c2; k2 = fuz_rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = fuz_rotl64(h2, 31); h2 += h1; h2 = h2*5 + 0x38495ab5;
+    }
+
+    // a tail of zero bytes leaves h1 and h2 unchanged, so the tail can always be mixed in
+    const uint8_t *tail = buf + nblocks*16;
+    uint64_t k1 = 0, k2 = 0;
+    for (size_t i = length & 15; i > 0; i--) {
+        if (i > 8) k2 ^= (uint64_t)tail[i - 1] << ((i - 9) * 8);
+        else k1 ^= (uint64_t)tail[i - 1] << ((i - 1) * 8);
+    }
+    k2 *= c2; k2 = fuz_rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    k1 *= c1; k1 = fuz_rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+
+    h1 ^= length; h2 ^= length;
+    h1 += h2; h2 += h1;
+    h1 = fuz_fmix64(h1); h2 = fuz_fmix64(h2);
+    h1 += h2; h2 += h1;
+
+    return std::make_pair(h2, h1);
+}
+
+std::string fuz_exact_to_string(const fuz_digest128 &digest)
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string out(FUZ_EXACT_HEX_LENGTH, '0');
+    for (int i = 0; i < 16; i++) {
+        out[15 - i] = hex[(digest.first >> (4 * i)) & 0xf];
+        out[31 - i] = hex[(digest.second >> (4 * i)) & 0xf];
+    }
+    return out;
+}
+
+bool fuz_exact_parse(const std::string &line, fuz_digest128 &digest, std::string &name)
+{
+    const size_t prefix = strlen(FUZ_EXACT_PREFIX);
+    if (line.compare(0, prefix, FUZ_EXACT_PREFIX) != 0) return false;
+    if (line.length() < prefix + FUZ_EXACT_HEX_LENGTH + 1 || line[prefix + FUZ_EXACT_HEX_LENGTH] != ':') return false;
+
+    digest = std::make_pair(0, 0);
+    for (int i = 0; i < FUZ_EXACT_HEX_LENGTH; i++) {
+        const char c = line[prefix + i];
+        uint64_t v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else return false;
+
+        uint64_t &half = i < 16 ? digest.first : digest.second;
+        half = (half << 4) | v;
+    }
+
+    name = line.substr(prefix + FUZ_EXACT_HEX_LENGTH + 1);
+    return true;
+}
+
+void fuz_exact_index::finalize()
+{
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+}
+
+void fuz_exact_index::lookup(const fuz_digest128 &digest, std::vector<uint32_t> &refs) const
+{
+    auto it = std::lower_bound(entries.begin(), entries.end(), std::make_pair(digest, (uint32_t)0));
+    for (; it != entries.end() && it->first == digest; ++it) {
+        refs.push_back(it->second);
+    }
+}
+
+void fuz_exact_hits::find(const fuz_exact_index &index, uint32_t query, const fuz_digest128 &digest, bool skip_matched,
+                          int32_t threshold)
+{
+    std::vector<uint32_t> refs;
+    index.lookup(digest, refs);
+    if (threshold <= 100) {
+        for (uint32_t ref : refs) matches.push_back({query, ref, 100});
+    }
+
+    if (skip.size() <= query) skip.resize(query + 1, false);
+    skip[query] = skip_matched && !refs.empty();
+}
+
+std::vector<fuz_match> fuz_merge_exact(const std::vector<fuz_match> &matches, const fuz_exact_hits &exact)
+{
+    if (exact.matches.empty()) return matches;
+
+    auto before = [](const fuz_match &a, const fuz_match &b) {
+        return a.query < b.query || (a.query == b.query && a.ref < b.ref);
+    };
+
+    std::vector<fuz_match> merged;
+    merged.reserve(matches.size() + exact.matches.size());
+    auto m = matches.begin();
+    for (const fuz_match &e : exact.matches) {
+        for (; m != matches.end() && before(*m, e); ++m) merged.push_back(*m);
+        if (m != matches.end() && m->query == e.query && m->ref == e.ref) ++m;
+        merged.push_back(e);
+    }
+    merged.insert(merged.end(), m, matches.end());
+    return merged;
+}
@@ -0,0 +1,71 @@
+/**
+ *
+ * fuz_exact:
+ *
+ * 128-bit block digests for byte-identical blocks
+ */
+
+#ifndef FUZ_EXACT_H
+#define FUZ_EXACT_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fuz_pool.h"
+
+// import files keep the digests in comment lines "#fuz_exact:<32 hex digits>:<block name>",
+// loaders of the similarity hashes skip them
+#define FUZ_EXACT_PREFIX "#fuz_exact:"
+#define FUZ_EXACT_HEX_LENGTH 32
+
+// (high, low) 64 bits of MurmurHash3 x64 128
+typedef std::pair<uint64_t, uint64_t> fuz_digest128;
+
+fuz_digest128 fuz_exact_digest(const uint8_t *buf, size_t length);
+std::string fuz_exact_to_string(const fuz_digest128 &digest);
+// parses a digest line, false for other lines
+bool fuz_exact_parse(const std::string &line, fuz_digest128 &digest, std::string &name);
+
+// imported digests, refs are the positions of the blocks in the imported similarity hash set
+struct fuz_exact_index {
+    fuz_exact_index() : entries() {}
+
+    void add(const fuz_digest128 &digest, uint32_t ref) { entries.push_back(std::make_pair(digest, ref)); }
+    // sorts the digests, has to be called before lookup
+    void finalize();
+    // appends the sorted refs with the digest
+    void lookup(const fuz_digest128 &digest, std::vector<uint32_t> &refs) const;
+
+    size_t size() const { return entries.size(); }
+
+private:
+    std::vector<std::pair<fuz_digest128, uint32_t> > entries;
+};
+
+// exact matches of the query blocks of one sbuf
+struct fuz_exact_hits {
+    fuz_exact_hits() : matches(), skip() {}
+
+    // queries have to be looked up in increasing order, matched queries are not compared by the similarity hash if skip_matched
+    // the matches are only kept if their score 100 reaches threshold
+    void find(const fuz_exact_index &index, uint32_t query, const fuz_digest128 &digest, bool skip_matched, int32_t threshold);
+    bool skipped(size_t query) const { return query < skip.size() && skip[query]; }
+
+    // sorted by query and ref, all with score 100
+    std::vector<fuz_match> matches;
+    std::vector<bool> skip;
+};
+
+// merges the sorted similarity matches with the exact matches, a pair found by both is reported once with score 100
+std::vector<fuz_match> fuz_merge_exact(const std::vector<fuz_match> &matches, const fuz_exact_hits &exact);
+
+// counters of all scans, reported at shutdown
+struct fuz_exact_stats {
+    std::atomic<uint64_t> matches{0};
+    std::atomic<uint64_t> skipped{0};
+};
+
+#endif
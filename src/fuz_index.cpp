@@ -0,0 +1,38 @@
+/**
+ *
+ * fuz_index:
+ *
+ * Sorted key to reference table shared by the inverted indexes and their candidate counters
+ */
+
+#include <algorithm>
+
+#include "fuz_index.h"
+
+void fuz_key_table::finalize()
+{
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    keys.clear();
+    offsets.clear();
+    refs.clear();
+    refs.reserve(entries.size());
+    for (auto &entry : entries) {
+        if (keys.empty() || keys.back() != entry.first) {
+            keys.push_back(entry.first);
+            offsets.push_back(refs.size());
+        }
+        refs.push_back(entry.second);
+    }
+    offsets.push_back(refs.size());
+    std::vector<std::pair<uint64_t, uint32_t> >().swap(entries);
+}
+
+void fuz_key_table::lookup(uint64_t key, std::vector<uint32_t> &out) const
+{
+    auto it = std::lower_bound(keys.begin(), keys.end(), key);
+    if (it == keys.end() || *it != key) return;
+    size_t k = it - keys.begin();
+    out.insert(out.end(), refs.begin() + offsets[k], refs.begin() + offsets[k + 1]);
+}
@@ -0,0 +1,40 @@
+/**
+ *
+ * fuz_index:
+ *
+ * Sorted key to reference table shared by the inverted indexes and their candidate counters
+ */
+
+#ifndef FUZ_INDEX_H
+#define FUZ_INDEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// maps 64-bit keys to the refs added under them
+struct fuz_key_table {
+    fuz_key_table() : entries(), keys(), offsets(), refs() {}
+
+    void add(uint64_t key, uint32_t ref) { entries.push_back(std::make_pair(key, ref)); }
+    // sorts the pairs and drops duplicates, has to be called before lookup
+    void finalize();
+    // appends the sorted refs of the key
+    void lookup(uint64_t key, std::vector<uint32_t> &out) const;
+
+private:
+    // (key, ref) pairs until finalize, then keys[i] owns refs[offsets[i], offsets[i+1])
+    std::vector<std::pair<uint64_t, uint32_t> > entries;
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> refs;
+};
+
+// candidate counters of all comparisons, reported at shutdown
+struct fuz_candidate_stats {
+    std::atomic<uint64_t> pairs{0};
+    std::atomic<uint64_t> candidates{0};
+};
+
+#endif
@@ -0,0 +1,609 @@
+/**
+ *
+ * fuz_mrshv2:
+ *
+ * Flat store and threshold-aware search over mrshv2 fingerprints
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FUZ_X86_KERNELS
+#endif
+
+#include "fuz_mrshv2.h"
+
+extern "C" {
+#include "mrshv2/header/popcount.h"
+}
+
+// allocates an aligned arena for the given amount of filters
+static unsigned char *fuz_arena_alloc(size_t filters, size_t filter_size = FILTERSIZE)
+{
+    void *arena = NULL;
+    if (posix_memalign(&arena, FUZ_ARENA_ALIGN, std::max<size_t>(filters, 1) * filter_size) != 0) {
+        std::cerr << "Malloc error\n";
+        exit(1);
+    }
+    return (unsigned char *)arena;
+}
+
+typedef void (*fuz_fold_kernel)(const uint64_t *fold, const unsigned char *const *filters, size_t count, int *bounds);
+
+static inline void fuz_fold_words(const uint64_t *fold, const unsigned char *const *filters, size_t count, int *bounds)
+{
+    for (size_t k = 0; k < count; k++) {
+        int bound = 0;
+        for (int i = 0; i < FILTERSIZE / 8; i++) {
+            uint64_t word;
+            memcpy(&word, filters[k] + 8*i, sizeof(word));
+            bound += __builtin_popcountll(word & fold[i % FUZ_FOLD_WORDS]);
+        }
+        bounds[k] = bound;
+    }
+}
+
+static void fuz_fold_bounds_scalar(const uint64_t *fold, const unsigned char *const *filters, size_t count, int *bounds)
+{
+    fuz_fold_words(fold, filters, count, bounds);
+}
+
+#ifdef FUZ_X86_KERNELS
+__attribute__((target("popcnt")))
+static void fuz_fold_bounds_popcnt(const uint64_t *fold, const unsigned char *const *filters, size_t count, int *bounds)
+{
+    fuz_fold_words(fold, filters, count, bounds);
+}
+
+// vpshufb nibble lookup like and_popcount_group_avx2, the fold stays in two registers
+__attribute__((target("avx2")))
+static void fuz_fold_bounds_avx2(const uint64_t *fold, const unsigned char *const *filters, size_t count, int *bounds)
+{
+    const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                            0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i folded[2] = {_mm256_loadu_si256((const __m256i *)fold), _mm256_loadu_si256((const __m256i *)(fold + 4))};
+
+    for (size_t k = 0; k < count; k++) {
+        __m256i byte_counts = _mm256_setzero_si256();
+        for (int i = 0; i < FILTERSIZE; i += 32) {
+            __m256i v = _mm256_and_si256(folded[(i / 32) % 2], _mm256_loadu_si256((const __m256i *)(filters[k] + i)));
+            __m256i lo = _mm256_and_si256(v, low_mask);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+            byte_counts = _mm256_add_epi8(byte_counts, _mm256_shuffle_epi8(lookup, lo));
+            byte_counts = _mm256_add_epi8(byte_counts, _mm256_shuffle_epi8(lookup, hi));
+        }
+        __m256i sums = _mm256_sad_epu8(byte_counts, _mm256_setzero_si256());
+        bounds[k] = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+                  + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+    }
+}
+
+// the fold is one register, a filter is four
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void fuz_fold_bounds_avx512(const uint64_t *fold, const unsigned char *const *filters, size_t count, int *bounds)
+{
+    const __m512i folded = _mm512_loadu_si512((const void *)fold);
+
+    for (size_t k = 0; k < count; k++) {
+        __m512i counts = _mm512_setzero_si512();
+        for (int i = 0; i < FILTERSIZE; i += FUZ_FOLD_BYTES) {
+            __m512i v = _mm512_and_si512(folded, _mm512_loadu_si512((const void *)(filters[k] + i)));
+            counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(v));
+        }
+        // the lanes are added in scalar code, the reduce intrinsic of gcc 12 warns about uninitialized registers
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512((void *)lanes, counts);
+        bounds[k] = lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+    }
+}
+#endif
+
+// fastest fold kernel of the cpu, picked once
+struct fuz_fold_kernel_choice {
+    fuz_fold_kernel_choice() : bounds(fuz_fold_bounds_scalar), name("scalar")
+    {
+#ifdef FUZ_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("popcnt")) {
+            bounds = fuz_fold_bounds_popcnt;
+            name = "popcnt";
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            bounds = fuz_fold_bounds_avx2;
+            name = "avx2";
+        }
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")) {
+            bounds = fuz_fold_bounds_avx512;
+            name = "avx512-vpopcntdq";
+        }
+#endif
+    }
+
+    fuz_fold_kernel bounds;
+    const char *name;
+};
+
+static const fuz_fold_kernel_choice &fuz_fold_selected_kernel()
+{
+    static const fuz_fold_kernel_choice kernel;
+    return kernel;
+}
+
+void fuz_fold_bounds(const uint64_t *fold, const unsigned char *const *filters, size_t count, int *bounds)
+{
+    fuz_fold_selected_kernel().bounds(fold, filters, count, bounds);
+}
+
+const char *fuz_fold_kernel_name()
+{
+    return fuz_fold_selected_kernel().name;
+}
+
+fuz_fp_store::fuz_fp_store()
+    : filters(NULL), filter_total(0), filter_capacity(0), blocks(), bits_set(), segments(),
+      first_filter(), filter_count(), name_offset(), names(), folds(NULL), buckets(), partitions(), single_filter_end(0)
+{
+}
+
+fuz_fp_store::~fuz_fp_store()
+{
+    free(filters);
+    free(folds);
+}
+
+void fuz_fp_store::add_fingerprint(const std::string &name)
+{
+    first_filter.push_back(filter_total);
+    filter_count.push_back(0);
+    name_offset.push_back(names.size());
+    names.append(name.c_str(), name.length() + 1);
+}
+
+void fuz_fp_store::add_filter(const unsigned char *filter, short filter_blocks)
+{
+    if (filter_total == filter_capacity) {
+        filter_capacity = std::max<size_t>(2*filter_capacity, 64);
+        unsigned char *grown = fuz_arena_alloc(filter_capacity);
+        if (filter_total) memcpy(grown, filters, filter_total*FILTERSIZE);
+        free(filters);
+        filters = grown;
+    }
+    memcpy(filters + filter_total*FILTERSIZE, filter, FILTERSIZE);
+
+    blocks.push_back(filter_blocks);
+    bits_set.push_back(and_popcount(filter, filter));
+    for (int s = 0; s < FUZ_SEGMENTS; s++) {
+        int count = 0;
+        for (int i = 0; i < FUZ_SEGMENT_BYTES; i += 8) {
+            uint64_t word;
+            memcpy(&word, filter + s*FUZ_SEGMENT_BYTES + i, sizeof(word));
+            count += __builtin_popcountll(word);
+        }
+        segments.push_back(count);
+    }
+
+    filter_total++;
+    filter_count.back()++;
+}
+
+void fuz_fp_store::add(const FINGERPRINT *fp, const std::string &name)
+{
+    add_fingerprint(name);
+    for (const BLOOMFILTER *bf = fp->bf_list; bf != NULL; bf = bf->next) {
+        add_filter(bf->array, bf->amount_of_blocks);
+    }
+}
+
+void fuz_fp_store::append(const fuz_fp_store &other)
+{
+    for (size_t fp = 0; fp < other.size(); fp++) {
+        add_fingerprint(other.name(fp));
+        for (uint32_t f = other.first_filter[fp]; f < other.first_filter[fp] + other.filter_count[fp]; f++) {
+            add_filter(other.filter(f), other.blocks[f]);
+        }
+    }
+}
+
+void fuz_fp_store::order_for_search()
+{
+    std::vector<size_t> order;
+    for (size_t i = 0; i < size(); i++) {
+        if (filter_count[i] == 1) order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        short blocks_a = blocks[first_filter[a]], blocks_b = blocks[first_filter[b]];
+        return blocks_a < blocks_b || (blocks_a == blocks_b && bits_set[first_filter[a]] < bits_set[first_filter[b]]);
+    });
+    single_filter_end = order.size();
+    for (size_t i = 0; i < size(); i++) {
+        if (filter_count[i] != 1) order.push_back(i);
+    }
+
+    // copy filters and metadata in search order, names stay where they are
+    unsigned char *ordered = fuz_arena_alloc(filter_total);
+    std::vector<short> ordered_blocks;
+    std::vector<unsigned short> ordered_bits_set;
+    std::vector<uint8_t> ordered_segments;
+    std::vector<uint32_t> ordered_first, ordered_count, ordered_names;
+    ordered_blocks.reserve(filter_total);
+    ordered_bits_set.reserve(filter_total);
+    ordered_segments.reserve(segments.size());
+
+    size_t f_out = 0;
+    for (size_t i : order) {
+        uint32_t f = first_filter[i];
+        memcpy(ordered + f_out*FILTERSIZE, filter(f), filter_count[i]*FILTERSIZE);
+        ordered_first.push_back(f_out);
+        ordered_count.push_back(filter_count[i]);
+        ordered_names.push_back(name_offset[i]);
+        for (uint32_t k = 0; k < filter_count[i]; k++) {
+            ordered_blocks.push_back(blocks[f + k]);
+            ordered_bits_set.push_back(bits_set[f + k]);
+            ordered_segments.insert(ordered_segments.end(), segment_counts(f + k), segment_counts(f + k) + FUZ_SEGMENTS);
+        }
+        f_out += filter_count[i];
+    }
+
+    free(filters);
+    filters = ordered;
+    filter_capacity = filter_total;
+    blocks.swap(ordered_blocks);
+    bits_set.swap(ordered_bits_set);
+    segments.swap(ordered_segments);
+    first_filter.swap(ordered_first);
+    filter_count.swap(ordered_count);
+    name_offset.swap(ordered_names);
+
+    buckets.clear();
+    for (size_t i = 0; i < single_filter_end; ) {
+        fuz_fp_bucket bucket;
+        bucket.begin = i;
+        bucket.blocks = blocks[first_filter[i]];
+        bucket.min_bits_set = bits_set[first_filter[i]];
+        memset(bucket.max_segments, 0, sizeof(bucket.max_segments));
+
+        while (i < single_filter_end && blocks[first_filter[i]] == bucket.blocks && i - bucket.begin < FUZ_BUCKET_SIZE) {
+            const uint8_t *seg = segment_counts(first_filter[i]);
+            for (int s = 0; s < FUZ_SEGMENTS; s++) {
+                bucket.max_segments[s] = std::max(bucket.max_segments[s], seg[s]);
+            }
+            i++;
+        }
+        bucket.end = i;
+        buckets.push_back(bucket);
+    }
+
+    // whole buckets per partition, the multi filter fingerprints are split by count
+    partitions.clear();
+    for (size_t b = 0; b < buckets.size(); ) {
+        fuz_fp_partition partition;
+        partition.bucket_begin = b;
+        partition.ref_begin = buckets[b].begin;
+        while (b < buckets.size() && buckets[b].end - partition.ref_begin <= FUZ_PARTITION_SIZE) b++;
+        if (b == partition.bucket_begin) b++;
+        partition.bucket_end = b;
+        partition.ref_end = buckets[b - 1].end;
+        partitions.push_back(partition);
+    }
+    for (size_t i = single_filter_end; i < size(); i += FUZ_PARTITION_SIZE / 16) {
+        partitions.push_back({i, std::min(size(), i + FUZ_PARTITION_SIZE / 16), buckets.size(), buckets.size()});
+    }
+}
+
+void fuz_fp_store::build_folds()
+{
+    free(folds);
+    folds = (uint64_t *)fuz_arena_alloc(filter_total, FUZ_FOLD_BYTES);
+    for (size_t f = 0; f < filter_total; f++) {
+        uint64_t *fold = folds + f*FUZ_FOLD_WORDS;
+        memset(fold, 0, FUZ_FOLD_BYTES);
+        for (int i = 0; i < FILTERSIZE / 8; i++) {
+            uint64_t word;
+            memcpy(&word, filter(f) + 8*i, sizeof(word));
+            fold[i % FUZ_FOLD_WORDS] |= word;
+        }
+    }
+}
+
+bool fuz_block_offset(const char *name, size_t &file_length, uint64_t &offset)
+{
+    const char *dash = strrchr(name, '-');
+    if (dash == NULL || dash[1] == '\0') return false;
+
+    offset = 0;
+    for (const char *c = dash + 1; *c != '\0'; c++) {
+        if (*c < '0' || *c > '9') return false;
+        offset = offset*10 + (*c - '0');
+    }
+    file_length = dash - name;
+    return true;
+}
+
+std::vector<uint32_t> fuz_fp_successors(const fuz_fp_store &store, uint64_t step)
+{
+    struct block {
+        size_t file_length;
+        uint64_t offset;
+        uint32_t fp;
+    };
+    std::vector<block> blocks;
+    for (size_t fp = 0; fp < store.size(); fp++) {
+        block b = {0, 0, (uint32_t)fp};
+        if (fuz_block_offset(store.name(fp), b.file_length, b.offset)) blocks.push_back(b);
+    }
+
+    // blocks of a file end up next to each other, ordered by offset
+    std::sort(blocks.begin(), blocks.end(), [&store](const block &a, const block &b) {
+        int files = strncmp(store.name(a.fp), store.name(b.fp), std::min(a.file_length, b.file_length));
+        if (files != 0) return files < 0;
+        if (a.file_length != b.file_length) return a.file_length < b.file_length;
+        return a.offset < b.offset;
+    });
+
+    std::vector<uint32_t> successors(store.size(), FUZ_NO_SUCCESSOR);
+    for (size_t i = 1; i < blocks.size(); i++) {
+        const block &a = blocks[i - 1], &b = blocks[i];
+        if (a.file_length == b.file_length && b.offset == a.offset + step &&
+            strncmp(store.name(a.fp), store.name(b.fp), a.file_length) == 0) {
+            successors[a.fp] = b.fp;
+        }
+    }
+    return successors;
+}
+
+fuz_fp_slices::fuz_fp_slices()
+    : words(0), slices(), word_ref(), word_size(), word_blocks(), word_min_bits_set(), word_max_segments()
+{
+}
+
+void fuz_fp_slices::build(const fuz_fp_store &store)
+{
+    word_ref.clear();
+    word_size.clear();
+    word_blocks.clear();
+    word_min_bits_set.clear();
+    word_max_segments.clear();
+
+    for (size_t r = 0; r < store.single_filter_end; ) {
+        const short blocks = store.blocks[store.first_filter[r]];
+        word_ref.push_back(r);
+        word_blocks.push_back(blocks);
+        word_min_bits_set.push_back(store.bits_set[store.first_filter[r]]);
+        word_max_segments.resize(word_max_segments.size() + FUZ_SEGMENTS, 0);
+
+        size_t n = 0;
+        for (; r < store.single_filter_end && n < FUZ_SLICE_WORD_BITS && store.blocks[store.first_filter[r]] == blocks; r++, n++) {
+            const uint8_t *seg = store.segment_counts(store.first_filter[r]);
+            uint8_t *max_seg = &word_max_segments[word_max_segments.size() - FUZ_SEGMENTS];
+            for (int s = 0; s < FUZ_SEGMENTS; s++) max_seg[s] = std::max(max_seg[s], seg[s]);
+        }
+        word_size.push_back(n);
+    }
+
+    // whole partitions, the padding words are empty
+    while (word_ref.size() % FUZ_SLICE_PARTITION_WORDS) {
+        word_ref.push_back(store.single_filter_end);
+        word_size.push_back(0);
+        word_blocks.push_back(0);
+        word_min_bits_set.push_back(0);
+        word_max_segments.resize(word_max_segments.size() + FUZ_SEGMENTS, 0);
+    }
+    words = word_ref.size();
+
+    slices.assign((size_t)FILTERSIZE * 8 * words, 0);
+    for (size_t w = 0; w < words; w++) {
+        for (size_t i = 0; i < word_size[w]; i++) {
+            const unsigned char *filter = store.filter(store.first_filter[word_ref[w] + i]);
+            for (int byte = 0; byte < FILTERSIZE; byte++) {
+                for (unsigned bits = filter[byte]; bits; bits &= bits - 1) {
+                    slices[(byte*8 + __builtin_ctz(bits)) * words + w] |= 1ULL << i;
+                }
+            }
+        }
+    }
+}
+
+// carry save adder of three bit-sliced inputs
+static inline void fuz_csa(uint64_t &high, uint64_t &low, uint64_t a, uint64_t b, uint64_t c)
+{
+    const uint64_t u = a ^ b;
+    high = (a & b) | (u & c);
+    low = u ^ c;
+}
+
+size_t fuz_fp_slices::candidates(const unsigned char *filter, const uint8_t *segments, short blocks, unsigned short bits_set,
+                                 int threshold, size_t partition, std::vector<uint32_t> &refs) const
+{
+    const size_t W = FUZ_SLICE_PARTITION_WORDS;
+    const size_t word_begin = partition * W;
+    int needed[FUZ_SLICE_PARTITION_WORDS];
+    bool any_active = false;
+    size_t total = 0;
+
+    // bits needed by the fingerprint of a word with the fewest bits set are enough for all of them
+    for (size_t k = 0; k < W; k++) {
+        const size_t w = word_begin + k;
+        total += word_size[w];
+        needed[k] = -1;
+        if (word_size[w] == 0 || blocks < MINBLOCKS || word_blocks[w] < MINBLOCKS) continue;
+
+        int need = fuz_bits_needed(word_blocks[w], blocks, std::min(bits_set, word_min_bits_set[w]), threshold);
+        if (need > bits_set || fuz_common_bound(segments, &word_max_segments[w * FUZ_SEGMENTS]) < need) continue;
+        needed[k] = std::max(need, 0);
+        any_active = true;
+    }
+    if (!any_active) return total;
+
+    // counts[p][k] is bit p of the bits in common of the fingerprints of word k, a plain binary counter per fingerprint
+    int planes = 1;
+    while (planes < FUZ_SLICE_PLANES && (1 << planes) <= bits_set) planes++;
+    uint64_t counts[FUZ_SLICE_PLANES][FUZ_SLICE_PARTITION_WORDS];
+    memset(counts, 0, sizeof(counts));
+
+    const uint64_t *query_slices[FILTERSIZE * 8];
+    int query_bits = 0;
+    for (int byte = 0; byte < FILTERSIZE; byte++) {
+        for (unsigned bits = filter[byte]; bits; bits &= bits - 1) {
+            query_slices[query_bits++] = slices.data() + (byte*8 + __builtin_ctz(bits)) * words + word_begin;
+        }
+    }
+
+    // Harley-Seal: 16 slices at a time through a tree of carry save adders into the four lowest planes,
+    // the carry of the tree is added to the planes above
+    int i = 0;
+    for (; i + 16 <= query_bits && planes > 4; i += 16) {
+        const uint64_t *const *in = query_slices + i;
+        for (size_t k = 0; k < W; k++) {
+            uint64_t ones = counts[0][k], twos = counts[1][k], fours = counts[2][k], eights = counts[3][k];
+            uint64_t twos_a, twos_b, fours_a, fours_b, eights_a, eights_b, carry;
+
+            fuz_csa(twos_a, ones, ones, in[0][k], in[1][k]);
+            fuz_csa(twos_b, ones, ones, in[2][k], in[3][k]);
+            fuz_csa(fours_a, twos, twos, twos_a, twos_b);
+            fuz_csa(twos_a, ones, ones, in[4][k], in[5][k]);
+            fuz_csa(twos_b, ones, ones, in[6][k], in[7][k]);
+            fuz_csa(fours_b, twos, twos, twos_a, twos_b);
+            fuz_csa(eights_a, fours, fours, fours_a, fours_b);
+            fuz_csa(twos_a, ones, ones, in[8][k], in[9][k]);
+            fuz_csa(twos_b, ones, ones, in[10][k], in[11][k]);
+            fuz_csa(fours_a, twos, twos, twos_a, twos_b);
+            fuz_csa(twos_a, ones, ones, in[12][k], in[13][k]);
+            fuz_csa(twos_b, ones, ones, in[14][k], in[15][k]);
+            fuz_csa(fours_b, twos, twos, twos_a, twos_b);
+            fuz_csa(eights_b, fours, fours, fours_a, fours_b);
+            fuz_csa(carry, eights, eights, eights_a, eights_b);
+
+            counts[0][k] = ones;
+            counts[1][k] = twos;
+            counts[2][k] = fours;
+            counts[3][k] = eights;
+            for (int p = 4; p < planes; p++) {
+                const uint64_t next = counts[p][k] & carry;
+                counts[p][k] ^= carry;
+                carry = next;
+            }
+        }
+    }
+    // remaining slices one at a time
+    for (; i < query_bits; i++) {
+        for (size_t k = 0; k < W; k++) {
+            uint64_t carry = query_slices[i][k];
+            for (int p = 0; p < planes; p++) {
+                const uint64_t next = counts[p][k] & carry;
+                counts[p][k] ^= carry;
+                carry = next;
+            }
+        }
+    }
+
+    for (size_t k = 0; k < W; k++) {
+        if (needed[k] < 0) continue;
+
+        // counts >= needed, compared from the highest plane down
+        uint64_t greater = 0, equal = ~0ULL;
+        for (int p = planes - 1; p >= 0; p--) {
+            if ((needed[k] >> p) & 1) {
+                equal &= counts[p][k];
+            } else {
+                greater |= equal & counts[p][k];
+                equal &= ~counts[p][k];
+            }
+        }
+
+        const size_t w = word_begin + k;
+        uint64_t mask = greater | equal;
+        if (word_size[w] < FUZ_SLICE_WORD_BITS) mask &= (1ULL << word_size[w]) - 1;
+        for (; mask; mask &= mask - 1) refs.push_back(word_ref[w] + __builtin_ctzll(mask));
+    }
+    return total;
+}
+
+// mrshv2s bloom_max_score on the store: best score of a filter against all filters of a fingerprint
+static int fuz_bloom_max_score(const fuz_fp_store &store1, size_t f1, const fuz_fp_store &store2, size_t fp2)
+{
+    int C, e_min, e_max;
+    int tmp_score = 0;
+    int score = 0;
+    const int bits1 = store1.bits_set[f1];
+    const short blocks1 = store1.blocks[f1];
+    const size_t first = store2.first_filter[fp2];
+    const size_t last = first + store2.filter_count[fp2] - 1;
+
+    e_min = lookup_e_min(blocks1, store2.blocks[first]);
+
+    for (size_t f2 = first; f2 <= last; f2++) {
+        // filters with less than MINBLOCKS blocks end the comparison
+        if (store2.blocks[f2] < MINBLOCKS) return score;
+
+        // for the last filter we have to update the values
+        if (f2 == last) e_min = lookup_e_min(store2.blocks[f2], blocks1);
+
+        e_max = MIN(bits1, store2.bits_set[f2]);
+        C = compute_cut_off(e_min, e_max);
+
+        // unsigned like in mrshv2, a negative C never scores
+        unsigned int common = and_popcount(store2.filter(f2), store1.filter(f1));
+
+        if (common < (unsigned int)C) {
+            tmp_score = 0;
+        } else {
+            if ((e_max - C) >= 1) tmp_score = 100*(common-C)/(e_max-C);
+        }
+
+        if (score < tmp_score) {
+            score = tmp_score;
+            if (score == 100) break;
+        }
+    }
+    return score;
+}
+
+int fuz_fp_compare(const fuz_fp_store &store1, size_t fp1, const fuz_fp_store &store2, size_t fp2)
+{
+    int final_score = 0;
+    int amount_of_BF;
+
+    const fuz_fp_store *larger = &store1, *smaller = &store2;
+    size_t larger_fp = fp1, smaller_fp = fp2;
+
+    // smaller fingerprint needs to be identified to generate the correct match score
+    if (store1.filter_count[fp1] < store2.filter_count[fp2]) {
+        larger = &store2; larger_fp = fp2;
+        smaller = &store1; smaller_fp = fp1;
+    }
+
+    // in case of file comparison we need the bigger value
+    const fuz_fp_store *counted = mode->file_comparison ? larger : smaller;
+    size_t counted_fp = mode->file_comparison ? larger_fp : smaller_fp;
+    amount_of_BF = counted->filter_count[counted_fp];
+    if (counted->blocks[counted->first_filter[counted_fp] + counted->filter_count[counted_fp] - 1] < MINBLOCKS)
+        amount_of_BF--;
+
+    // run through all filters of the smaller fingerprint and compare them to all filters of the larger one
+    const size_t first = smaller->first_filter[smaller_fp];
+    for (size_t f = first; f < first + smaller->filter_count[smaller_fp]; f++) {
+        if (smaller->blocks[f] < MINBLOCKS) break;
+        final_score += fuz_bloom_max_score(*smaller, f, *larger, larger_fp);
+    }
+
+    if (amount_of_BF < 1) return 0;
+    return final_score/amount_of_BF;
+}
+
+// a single filter pair scores 100*(common-C)/(e_max-C) if common >= C, so reaching the threshold
+// needs common >= C + ceil(threshold*(e_max-C)/100). e_min is looked up in the same order as in
+// bloom_max_score for the last filter, the result is non-decreasing in e_max and both block counts
+int fuz_bits_needed(int blocks_ref, int blocks_query, int e_max, int threshold)
+{
+    if (threshold <= 0) return 0;
+    if (threshold > 100) return -1;
+
+    // bloom_max_score never sets a score for pairs with e_max - C < 1
+    int e_min = lookup_e_min(blocks_ref, blocks_query);
+    return fuz_bits_needed_cut_off(compute_cut_off(e_min, e_max), e_max, threshold);
+}
@@ -0,0 +1,212 @@
+/**
+ *
+ * fuz_mrshv2:
+ *
+ * Flat store and threshold-aware search over mrshv2 fingerprints
+ */
+
+#ifndef FUZ_MRSHV2_H
+#define FUZ_MRSHV2_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// mrshv2
+extern "C" {
+#include "mrshv2/header/config.h"
+#include "mrshv2/header/hashing.h"
+#include "mrshv2/header/fingerprintList.h"
+}
+
+// popcounts of FUZ_SEGMENTS equal parts of a filter
+// two filters cannot have more bits in common than the sum of the per segment minimums
+#define FUZ_SEGMENTS 16
+#define FUZ_SEGMENT_BYTES (FILTERSIZE / FUZ_SEGMENTS)
+
+// maximum amount of fingerprints sharing one bucket bound
+// a bucket is also the tile of reference filters that is kept in cache (512 filters are 128 KiB)
+#define FUZ_BUCKET_SIZE 512
+
+// fingerprints per word of a bit slice, words per slice partition and bit planes of the counters
+// (filters have at most FILTERSIZE*8 = 2048 bits set, 12 planes count up to 4095)
+#define FUZ_SLICE_WORD_BITS 64
+#define FUZ_SLICE_PARTITION_WORDS (FUZ_PARTITION_SIZE / FUZ_SLICE_WORD_BITS)
+#define FUZ_SLICE_PLANES 12
+
+// alignment of the filter arena
+#define FUZ_ARENA_ALIGN 64
+
+// reference filters OR-folded to FUZ_FOLD_BYTES, every bit a query has in common with a reference is set in the fold,
+// so the query against the fold bounds the bits in common while reading a quarter of the reference
+#define FUZ_FOLD_BYTES 64
+#define FUZ_FOLD_WORDS (FUZ_FOLD_BYTES / 8)
+
+// amount of fingerprints a comparison partition aims for
+#define FUZ_PARTITION_SIZE 1024
+
+// run of single filter fingerprints with the same block count, sorted by bits set
+// max_segments bounds the segment popcounts of every fingerprint in the run
+struct fuz_fp_bucket {
+    size_t begin;
+    size_t end;
+    short blocks;
+    unsigned short min_bits_set;
+    uint8_t max_segments[FUZ_SEGMENTS];
+};
+
+// unit of parallel work: the fingerprints [ref_begin, ref_end), the buckets among them are [bucket_begin, bucket_end)
+struct fuz_fp_partition {
+    size_t ref_begin;
+    size_t ref_end;
+    size_t bucket_begin;
+    size_t bucket_end;
+};
+
+// structure-of-arrays store of mrshv2 fingerprints
+// all filters live in one contiguous arena, fingerprint i owns the filters
+// [first_filter[i], first_filter[i] + filter_count[i]) and the name at name_offset[i]
+struct fuz_fp_store {
+    fuz_fp_store();
+    ~fuz_fp_store();
+    fuz_fp_store(const fuz_fp_store &) = delete;
+    fuz_fp_store &operator=(const fuz_fp_store &) = delete;
+
+    // starts a new fingerprint, following filters are added to it
+    void add_fingerprint(const std::string &name);
+    void add_filter(const unsigned char *filter, short blocks);
+    // copies a hashed mrshv2 fingerprint
+    void add(const FINGERPRINT *fp, const std::string &name);
+    // copies all fingerprints of another store in their order
+    void append(const fuz_fp_store &other);
+
+    // reorders single filter fingerprints by block count and bits set and builds the buckets and partitions
+    // fingerprints with more than one filter are moved behind them
+    void order_for_search();
+    // folds every filter to FUZ_FOLD_BYTES, call after order_for_search
+    void build_folds();
+
+    size_t size() const { return first_filter.size(); }
+    const unsigned char *filter(size_t f) const { return filters + f*FILTERSIZE; }
+    const uint8_t *segment_counts(size_t f) const { return segments.data() + f*FUZ_SEGMENTS; }
+    const uint64_t *fold(size_t f) const { return folds + f*FUZ_FOLD_WORDS; }
+    const char *name(size_t fp) const { return names.data() + name_offset[fp]; }
+
+    // per filter
+    unsigned char *filters;
+    size_t filter_total;
+    size_t filter_capacity;
+    std::vector<short> blocks;
+    std::vector<unsigned short> bits_set;
+    std::vector<uint8_t> segments;
+
+    // per fingerprint
+    std::vector<uint32_t> first_filter;
+    std::vector<uint32_t> filter_count;
+    std::vector<uint32_t> name_offset;
+    std::string names;
+
+    // search order, valid after order_for_search, and folded filters, NULL unless build_folds was called
+    uint64_t *folds;
+    std::vector<fuz_fp_bucket> buckets;
+    std::vector<fuz_fp_partition> partitions;
+    size_t single_filter_end;
+};
+
+// transposed copy of the single filter fingerprints of a store ordered for search
+// slice b holds bit b of the filters of FUZ_SLICE_WORD_BITS fingerprints per word, so a query only reads the slices
+// of the bits it has set and counts the bits in common of all fingerprints of a word at once
+// the fingerprints of a word have the same block count and are sorted by bits set like in the store
+struct fuz_fp_slices {
+    fuz_fp_slices();
+
+    void build(const fuz_fp_store &store);
+
+    size_t partitions() const { return (words + FUZ_SLICE_PARTITION_WORDS - 1) / FUZ_SLICE_PARTITION_WORDS; }
+    // appends the fingerprints of a partition that have enough bits in common with a single filter query to reach threshold
+    // returns the amount of fingerprints in the partition
+    size_t candidates(const unsigned char *filter, const uint8_t *segments, short blocks, unsigned short bits_set,
+                      int threshold, size_t partition, std::vector<uint32_t> &refs) const;
+
+    // words per slice, a multiple of FUZ_SLICE_PARTITION_WORDS
+    size_t words;
+    // slices[bit * words + w]
+    std::vector<uint64_t> slices;
+    // first fingerprint, fingerprint count, block count, smallest bits set and largest segment popcounts of word w
+    std::vector<uint32_t> word_ref;
+    std::vector<uint8_t> word_size;
+    std::vector<short> word_blocks;
+    std::vector<unsigned short> word_min_bits_set;
+    std::vector<uint8_t> word_max_segments;
+};
+
+// pair counters of all comparisons, reported at shutdown
+struct fuz_prune_stats {
+    std::atomic<uint64_t> pairs{0};
+    std::atomic<uint64_t> pruned_query{0};
+    std::atomic<uint64_t> pruned_bucket{0};
+    std::atomic<uint64_t> pruned_bound{0};
+    std::atomic<uint64_t> pruned_fold{0};
+    std::atomic<uint64_t> pruned_slices{0};
+};
+
+// same score as mrshv2s fingerprint_compare(fingerprint1, fingerprint2)
+int fuz_fp_compare(const fuz_fp_store &store1, size_t fp1, const fuz_fp_store &store2, size_t fp2);
+
+// minimum bits in common a pair needs to reach threshold, -1 if it cannot reach it at all
+int fuz_bits_needed(int blocks_ref, int blocks_query, int e_max, int threshold);
+
+// fuz_bits_needed for an already computed cut-off C
+inline int fuz_bits_needed_cut_off(int C, int e_max, int threshold)
+{
+    if (threshold <= 0) return 0;
+    if (threshold > 100 || e_max - C < 1) return -1;
+    return C + (threshold * (e_max - C) + 99) / 100;
+}
+
+// fuz_fp_compare of two single filter fingerprints from their bits in common and cut-off C,
+// both filters have at least MINBLOCKS blocks
+inline int fuz_filter_score_cut_off(int C, int e_max, unsigned int common)
+{
+    // unsigned like in mrshv2, a negative C never scores
+    if (common < (unsigned int)C || (e_max - C) < 1) return 0;
+    return 100*(common-C)/(e_max-C);
+}
+
+// upper bound of the bits two filters have in common
+inline int fuz_common_bound(const uint8_t *segments1, const uint8_t *segments2)
+{
+    int bound = 0;
+    for (int s = 0; s < FUZ_SEGMENTS; s++) {
+        bound += segments1[s] < segments2[s] ? segments1[s] : segments2[s];
+    }
+    return bound;
+}
+
+// bounds[k] = upper bound of the bits filters[k] has in common with the reference folded into fold, for count filters
+// the fold is loaded once for all of them
+void fuz_fold_bounds(const uint64_t *fold, const unsigned char *const *filters, size_t count, int *bounds);
+
+// name of the fold kernel selected for the cpu
+const char *fuz_fold_kernel_name();
+
+// splits a block name "<file>-<offset>" into the length of its file part and the offset, false for other names
+bool fuz_block_offset(const char *name, size_t &file_length, uint64_t &offset);
+
+// successors[fp] is the fingerprint of the same file step bytes behind fp, FUZ_NO_SUCCESSOR if there is none
+#define FUZ_NO_SUCCESSOR UINT32_MAX
+std::vector<uint32_t> fuz_fp_successors(const fuz_fp_store &store, uint64_t step);
+
+// blocks that are always compared with all imported blocks when the successors of matches are predicted,
+// every FUZ_PREDICT_SEED_INTERVAL-th block and the first block of a run
+#define FUZ_PREDICT_SEED_INTERVAL 16
+
+// counters of the predicted successors, reported at shutdown
+struct fuz_predict_stats {
+    std::atomic<uint64_t> seeds{0};
+    std::atomic<uint64_t> predicted{0};
+    std::atomic<uint64_t> confirmed{0};
+};
+
+#endif
@@ -0,0 +1,189 @@
+/**
+ *
+ * fuz_pool:
+ *
+ * Work stealing thread pool for comparisons inside a single sbuf
+ * and a bounded queue of whole sbuf comparisons for dedicated threads
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "fuz_pool.h"
+
+std::vector<fuz_match> fuz_merge_matches(std::vector<std::vector<fuz_match> > &buffers)
+{
+    size_t total = 0;
+    for (auto &buffer : buffers) total += buffer.size();
+
+    std::vector<fuz_match> matches;
+    matches.reserve(total);
+    for (auto &buffer : buffers) {
+        matches.insert(matches.end(), buffer.begin(), buffer.end());
+        std::vector<fuz_match>().swap(buffer);
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const fuz_match &a, const fuz_match &b) {
+        return a.query < b.query || (a.query == b.query && a.ref < b.ref);
+    });
+    return matches;
+}
+
+fuz_pool::fuz_pool(unsigned thread_count)
+    : threads(), queues(), queued(0), stop(false), sleep_mutex(), wake()
+{
+    for (unsigned w = 0; w < thread_count; w++) queues.emplace_back(new queue());
+    for (unsigned w = 0; w < thread_count; w++) threads.emplace_back(&fuz_pool::work, this, w);
+}
+
+fuz_pool::~fuz_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto &thread : threads) thread.join();
+}
+
+void fuz_pool::run(job &j, size_t partition, unsigned worker)
+{
+    if (j.taken[partition].exchange(true)) return;
+    j.fn(partition, worker);
+
+    if (--j.remaining == 0) {
+        std::lock_guard<std::mutex> lock(j.done_mutex);
+        j.done.notify_all();
+    }
+}
+
+void fuz_pool::parallel_for(size_t count, const std::function<void(size_t, unsigned)> &fn)
+{
+    if (count == 0) return;
+
+    std::shared_ptr<job> j(new job(count, fn));
+    const unsigned caller = workers() - 1;
+
+    if (threads.empty()) {
+        for (size_t p = 0; p < count; p++) run(*j, p, caller);
+        return;
+    }
+
+    // counted before they are queued, so a worker that pops one right away never takes queued below 0
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        queued += count;
+    }
+    // deal the partitions round robin, the caller takes them from the other end
+    for (size_t p = 0; p < count; p++) {
+        queue &q = *queues[p % queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(task(j, p));
+    }
+    wake.notify_all();
+
+    for (size_t p = count; p-- > 0; ) run(*j, p, caller);
+
+    std::unique_lock<std::mutex> lock(j->done_mutex);
+    j->done.wait(lock, [&j] { return j->remaining == 0; });
+}
+
+bool fuz_pool::pop(unsigned worker, task &t)
+{
+    // newest own partition first, then the oldest partition of another worker
+    for (size_t i = 0; i < queues.size(); i++) {
+        queue &q = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) continue;
+
+        if (i == 0) {
+            t = q.tasks.back();
+            q.tasks.pop_back();
+        } else {
+            t = q.tasks.front();
+            q.tasks.pop_front();
+        }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void fuz_pool::work(unsigned worker)
+{
+    while (true) {
+        task t;
+        if (pop(worker, t)) {
+            run(*t.owner, t.partition, worker);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this] { return stop || queued > 0; });
+        if (stop && queued == 0) return;
+    }
+}
+
+fuz_job_queue::fuz_job_queue(unsigned thread_count, size_t queue_capacity)
+    : stats(), threads(), jobs(), capacity(std::max<size_t>(queue_capacity, 1)), running(0), stop(false), mutex(),
+      not_empty(), not_full(), idle()
+{
+    for (unsigned t = 0; t < thread_count; t++) threads.emplace_back(&fuz_job_queue::work, this);
+}
+
+fuz_job_queue::~fuz_job_queue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    not_empty.notify_all();
+    for (auto &thread : threads) thread.join();
+}
+
+void fuz_job_queue::push(const std::function<void()> &job)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (jobs.size() >= capacity) {
+        stats.waits++;
+        not_full.wait(lock, [this] { return jobs.size() < capacity; });
+    }
+    jobs.push_back(job);
+    stats.jobs++;
+    if (jobs.size() > stats.max_depth) stats.max_depth = jobs.size();
+    lock.unlock();
+    not_empty.notify_one();
+}
+
+void fuz_job_queue::drain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return jobs.empty() && running == 0; });
+}
+
+size_t fuz_job_queue::depth() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size();
+}
+
+void fuz_job_queue::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        not_empty.wait(lock, [this] { return stop || !jobs.empty(); });
+        if (jobs.empty()) return;
+
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+        running++;
+        lock.unlock();
+        not_full.notify_one();
+
+        job();
+
+        lock.lock();
+        running--;
+        if (jobs.empty() && running == 0) idle.notify_all();
+    }
+}
@@ -0,0 +1,125 @@
+/**
+ *
+ * fuz_pool:
+ *
+ * Work stealing thread pool for comparisons inside a single sbuf
+ * and a bounded queue of whole sbuf comparisons for dedicated threads
+ */
+
+#ifndef FUZ_POOL_H
+#define FUZ_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// reported pair of a query and an imported (reference) hash
+struct fuz_match {
+    uint32_t query;
+    uint32_t ref;
+    int score;
+};
+
+// merges per worker result buffers into one list sorted by query and reference
+std::vector<fuz_match> fuz_merge_matches(std::vector<std::vector<fuz_match> > &buffers);
+
+// pool of comparison workers owned by the plugin
+// every worker has its own deque of partitions, idle workers steal from the others
+// with 0 threads all partitions run in the calling thread
+class fuz_pool {
+public:
+    explicit fuz_pool(unsigned threads);
+    ~fuz_pool();
+    fuz_pool(const fuz_pool &) = delete;
+    fuz_pool &operator=(const fuz_pool &) = delete;
+
+    // amount of result buffers a caller needs, the calling thread uses the last one
+    unsigned workers() const { return threads.size() + 1; }
+
+    // runs fn(partition, worker) for all partitions in [0, count) and returns when all are done
+    // the calling thread works on its own partitions as well, several callers may run at once
+    void parallel_for(size_t count, const std::function<void(size_t, unsigned)> &fn);
+
+private:
+    struct job {
+        explicit job(size_t count, const std::function<void(size_t, unsigned)> &f)
+            : fn(f), taken(new std::atomic<bool>[count]), remaining(count), done_mutex(), done() {
+            for (size_t p = 0; p < count; p++) taken[p] = false;
+        }
+        const std::function<void(size_t, unsigned)> &fn;
+        std::unique_ptr<std::atomic<bool>[]> taken;
+        std::atomic<size_t> remaining;
+        std::mutex done_mutex;
+        std::condition_variable done;
+    };
+    struct task {
+        task() : owner(), partition(0) {}
+        task(const std::shared_ptr<job> &j, size_t p) : owner(j), partition(p) {}
+        std::shared_ptr<job> owner;
+        size_t partition;
+    };
+    struct queue {
+        queue() : mutex(), tasks() {}
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    // runs the partition unless another thread already took it
+    static void run(job &j, size_t partition, unsigned worker);
+    bool pop(unsigned worker, task &t);
+    void work(unsigned worker);
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<queue> > queues;
+    std::atomic<size_t> queued;
+    std::atomic<bool> stop;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+};
+
+// counters of the job queue, reported at shutdown
+struct fuz_queue_stats {
+    std::atomic<uint64_t> jobs{0};
+    std::atomic<uint64_t> max_depth{0};
+    std::atomic<uint64_t> waits{0};
+};
+
+// comparison jobs of whole sbufs, run by threads of the plugin instead of the bulk_extractor threads that hashed them
+// push waits while capacity jobs are queued, so hashing cannot run unboundedly ahead of the comparisons
+class fuz_job_queue {
+public:
+    fuz_job_queue(unsigned threads, size_t capacity);
+    // runs the queued jobs before the threads stop
+    ~fuz_job_queue();
+    fuz_job_queue(const fuz_job_queue &) = delete;
+    fuz_job_queue &operator=(const fuz_job_queue &) = delete;
+
+    void push(const std::function<void()> &job);
+    // returns when no job is queued or running
+    void drain();
+    // jobs waiting for a thread
+    size_t depth() const;
+
+    fuz_queue_stats stats;
+
+private:
+    void work();
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()> > jobs;
+    size_t capacity;
+    size_t running;
+    bool stop;
+    mutable std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::condition_variable idle;
+};
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ *
+ * fuz_presence:
+ *
+ * Per reference file coverage of the matched blocks for presence detection
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+#include "fuz_presence.h"
+
+fuz_presence::fuz_presence(const std::vector<std::string> &files, uint32_t coverage, uint64_t hits)
+    : min_coverage(coverage), min_hits(hits), names(), ref_file(files.size()), ref_begin(), file_refs(), mutex(), state(),
+      matched_refs(files.size(), false), retired_refs(new std::atomic<bool>[files.size()])
+{
+    std::unordered_map<std::string, uint32_t> ids;
+    for (size_t r = 0; r < files.size(); r++) {
+        auto it = ids.emplace(files[r], (uint32_t)names.size());
+        if (it.second) names.push_back(files[r]);
+        ref_file[r] = it.first->second;
+        retired_refs[r].store(false, std::memory_order_relaxed);
+    }
+
+    // counting sort of the refs by file
+    state.resize(names.size());
+    for (uint32_t f : ref_file) state[f].blocks++;
+    ref_begin.assign(names.size() + 1, 0);
+    for (size_t f = 0; f < names.size(); f++) ref_begin[f + 1] = ref_begin[f] + state[f].blocks;
+    std::vector<uint32_t> next(ref_begin.begin(), ref_begin.end() - 1);
+    file_refs.resize(files.size());
+    for (size_t r = 0; r < files.size(); r++) file_refs[next[ref_file[r]]++] = r;
+}
+
+void fuz_presence::record(const std::vector<fuz_presence_hit> &hits)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &hit : hits) {
+        const uint32_t f = ref_file[hit.ref];
+        file_state &file = state[f];
+
+        file.hits++;
+        if (!matched_refs[hit.ref]) {
+            matched_refs[hit.ref] = true;
+            file.matched++;
+        }
+        if (file.first.empty() || hit.offset < file.first_offset || (hit.offset == file.first_offset && hit.name < file.first)) {
+            file.first_offset = hit.offset;
+            file.first = hit.name;
+        }
+        if (file.last.empty() || hit.offset > file.last_offset || (hit.offset == file.last_offset && hit.name > file.last)) {
+            file.last_offset = hit.offset;
+            file.last = hit.name;
+        }
+
+        if (file.satisfied) continue;
+        if ((uint64_t)file.matched * 100 >= (uint64_t)file.blocks * min_coverage || (min_hits != 0 && file.hits >= min_hits)) {
+            file.satisfied = true;
+            for (uint32_t i = ref_begin[f]; i < ref_begin[f + 1]; i++) retired_refs[file_refs[i]].store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string fuz_presence::report(const std::string &sep) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint32_t> order;
+    for (uint32_t f = 0; f < names.size(); f++) {
+        if (state[f].hits != 0) order.push_back(f);
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return names[a] < names[b]; });
+
+    std::stringstream out;
+    out.fill('0');
+    for (uint32_t f : order) {
+        const file_state &file = state[f];
+        out << names[f] << sep << file.matched << sep << file.blocks << sep << std::setw(3) << file.matched * 100 / file.blocks
+            << sep << file.hits << sep << file.first << sep << file.last << std::endl;
+    }
+    return out.str();
+}
+
+size_t fuz_presence::satisfied() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::count_if(state.begin(), state.end(), [](const file_state &file) { return file.satisfied; });
+}
@@ -0,0 +1,80 @@
+/**
+ *
+ * fuz_presence:
+ *
+ * Per reference file coverage of the matched blocks for presence detection
+ */
+
+#ifndef FUZ_PRESENCE_H
+#define FUZ_PRESENCE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// a matched query block, offset is the position of the block in the scanned data
+struct fuz_presence_hit {
+    uint32_t ref;
+    uint64_t offset;
+    std::string name;
+};
+
+// imported blocks grouped by the file they were hashed from
+// a file is satisfied once enough of its blocks matched or it matched often enough,
+// its blocks are retired then and no longer compared
+class fuz_presence {
+public:
+    // files[ref] is the file of the imported block ref, coverage is in percent, hits 0 only checks the coverage
+    fuz_presence(const std::vector<std::string> &files, uint32_t coverage, uint64_t hits);
+    fuz_presence(const fuz_presence &) = delete;
+    fuz_presence &operator=(const fuz_presence &) = delete;
+
+    // read without locking by the comparison threads, a block can retire while a comparison runs
+    bool retired(uint32_t ref) const { return retired_refs[ref].load(std::memory_order_relaxed); }
+
+    // counts the hits and retires the blocks of the files that became satisfied
+    void record(const std::vector<fuz_presence_hit> &hits);
+
+    // one line per file with hits, "<file><sep><matched blocks><sep><blocks><sep><coverage><sep><hits><sep><first><sep><last>",
+    // first and last are the matched query blocks at the lowest and highest offset
+    std::string report(const std::string &sep) const;
+
+    size_t files() const { return names.size(); }
+    size_t satisfied() const;
+
+    // pairs the comparison threads skipped because the imported block was retired
+    std::atomic<uint64_t> skipped{0};
+
+private:
+    struct file_state {
+        file_state() : blocks(0), matched(0), hits(0), satisfied(false), first_offset(0), last_offset(0), first(), last() {}
+
+        uint32_t blocks;
+        uint32_t matched;
+        uint64_t hits;
+        bool satisfied;
+        uint64_t first_offset;
+        uint64_t last_offset;
+        std::string first;
+        std::string last;
+    };
+
+    uint32_t min_coverage;
+    uint64_t min_hits;
+
+    std::vector<std::string> names;
+    std::vector<uint32_t> ref_file;
+    // refs of every file, files[f] are ref_begin[f] to ref_begin[f + 1] of file_refs
+    std::vector<uint32_t> ref_begin;
+    std::vector<uint32_t> file_refs;
+
+    mutable std::mutex mutex;
+    std::vector<file_state> state;
+    std::vector<bool> matched_refs;
+    std::unique_ptr<std::atomic<bool>[]> retired_refs;
+};
+
+#endif
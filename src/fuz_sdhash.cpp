@@ -0,0 +1,528 @@
+/**
+ *
+ * fuz_sdhash:
+ *
+ * Candidate search and scoring over sdhash bloom filters
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FUZ_SDBF_X86_KERNELS
+#endif
+
+#include "fuz_sdhash.h"
+
+double fuz_lsh_jaccard(int threshold, int bits_small, int bits_large)
+{
+    if (bits_small <= 0 || bits_large <= 0) return 0;
+
+    // sdhash: cut_off = 0.3 * (max_est - min_est) + min_est, score = (match - cut_off) / (max_est - cut_off)
+    double max_est = std::min(bits_small, bits_large);
+    double min_est = (double)bits_small * bits_large / FUZ_SDBF_FILTER_BITS;
+    double cut_off = 0.3 * (max_est - min_est) + min_est;
+    double match = cut_off + std::min(threshold, 100) / 100.0 * (max_est - cut_off);
+
+    return match / (bits_small + bits_large - match);
+}
+
+fuz_lsh_index::fuz_lsh_index()
+    : rows(0), bands(0), ranks(), tables()
+{
+}
+
+void fuz_lsh_index::configure(double jaccard, double recall_target)
+{
+    rows = 1;
+    bands = FUZ_LSH_MAX_HASHES;
+
+    // more rows per band filter random pairs better, but need more bands for the same recall
+    for (uint32_t r = 1; r <= FUZ_LSH_MAX_HASHES; r++) {
+        double band_hit = pow(jaccard, r);
+        if (band_hit <= 0) break;
+        double b = band_hit >= 1 ? 1 : ceil(log(1 - recall_target) / log(1 - band_hit));
+        if (r * b > FUZ_LSH_MAX_HASHES) break;
+        rows = r;
+        bands = b;
+    }
+
+    // fixed seed, the same filters always give the same candidates
+    const uint32_t hashes = rows * bands;
+    std::mt19937 rng(0x5eed);
+    std::vector<uint16_t> permutation(FUZ_SDBF_FILTER_BITS);
+    std::iota(permutation.begin(), permutation.end(), 0);
+
+    ranks.assign(FUZ_SDBF_FILTER_BITS * hashes, 0);
+    for (uint32_t k = 0; k < hashes; k++) {
+        std::shuffle(permutation.begin(), permutation.end(), rng);
+        for (int bit = 0; bit < FUZ_SDBF_FILTER_BITS; bit++) {
+            ranks[bit * hashes + k] = permutation[bit];
+        }
+    }
+
+    tables.assign(bands, std::vector<std::pair<uint64_t, uint32_t> >());
+}
+
+bool fuz_lsh_index::band_keys(const uint8_t *filter, uint64_t *keys) const
+{
+    const uint32_t hashes = rows * bands;
+    uint16_t mins[FUZ_LSH_MAX_HASHES];
+    bool empty = true;
+    std::fill(mins, mins + hashes, 0xffff);
+
+    for (int i = 0; i < FUZ_SDBF_FILTER_SIZE; i += 8) {
+        uint64_t word;
+        memcpy(&word, filter + i, sizeof(word));
+        while (word) {
+            const uint16_t *bit_ranks = ranks.data() + (i*8 + __builtin_ctzll(word)) * hashes;
+            for (uint32_t k = 0; k < hashes; k++) {
+                mins[k] = std::min(mins[k], bit_ranks[k]);
+            }
+            word &= word - 1;
+            empty = false;
+        }
+    }
+    if (empty) return false;
+
+    for (uint32_t b = 0; b < bands; b++) {
+        uint64_t key = 0xcbf29ce484222325ULL ^ b;
+        for (uint32_t r = 0; r < rows; r++) {
+            key = (key ^ mins[b * rows + r]) * 0x100000001b3ULL;
+        }
+        keys[b] = key;
+    }
+    return true;
+}
+
+void fuz_lsh_index::add(uint32_t ref, const uint8_t *filter)
+{
+    uint64_t keys[FUZ_LSH_MAX_HASHES];
+    if (!band_keys(filter, keys)) return;
+
+    for (uint32_t b = 0; b < bands; b++) {
+        tables[b].push_back(std::make_pair(keys[b], ref));
+    }
+}
+
+void fuz_lsh_index::finalize()
+{
+    for (auto &table : tables) {
+        std::sort(table.begin(), table.end());
+    }
+}
+
+void fuz_lsh_index::candidates(const uint8_t *filter, std::vector<uint32_t> &refs) const
+{
+    uint64_t keys[FUZ_LSH_MAX_HASHES];
+    if (!band_keys(filter, keys)) return;
+
+    for (uint32_t b = 0; b < bands; b++) {
+        auto it = std::lower_bound(tables[b].begin(), tables[b].end(), std::make_pair(keys[b], (uint32_t)0));
+        for (; it != tables[b].end() && it->first == keys[b]; ++it) {
+            refs.push_back(it->second);
+        }
+    }
+}
+
+double fuz_lsh_index::recall(double jaccard) const
+{
+    return 1 - pow(1 - pow(jaccard, rows), bands);
+}
+
+// stages[k] = common bits of the two filters in bytes [0, 32), [32, 64), [64, 128) and [128, 256)
+typedef void (*fuz_sdbf_stage_kernel)(const uint8_t *filter1, const uint8_t *filter2, uint32_t *stages);
+
+static inline uint32_t fuz_sdbf_and_words(const uint8_t *filter1, const uint8_t *filter2, int begin, int end)
+{
+    uint32_t count = 0;
+    for (int i = begin; i < end; i += 8) {
+        uint64_t word1, word2;
+        memcpy(&word1, filter1 + i, sizeof(word1));
+        memcpy(&word2, filter2 + i, sizeof(word2));
+        count += __builtin_popcountll(word1 & word2);
+    }
+    return count;
+}
+
+static void fuz_sdbf_stages_scalar(const uint8_t *filter1, const uint8_t *filter2, uint32_t *stages)
+{
+    stages[0] = fuz_sdbf_and_words(filter1, filter2, 0, 32);
+    stages[1] = fuz_sdbf_and_words(filter1, filter2, 32, 64);
+    stages[2] = fuz_sdbf_and_words(filter1, filter2, 64, 128);
+    stages[3] = fuz_sdbf_and_words(filter1, filter2, 128, FUZ_SDBF_FILTER_SIZE);
+}
+
+#ifdef FUZ_SDBF_X86_KERNELS
+__attribute__((target("popcnt")))
+static void fuz_sdbf_stages_popcnt(const uint8_t *filter1, const uint8_t *filter2, uint32_t *stages)
+{
+    stages[0] = fuz_sdbf_and_words(filter1, filter2, 0, 32);
+    stages[1] = fuz_sdbf_and_words(filter1, filter2, 32, 64);
+    stages[2] = fuz_sdbf_and_words(filter1, filter2, 64, 128);
+    stages[3] = fuz_sdbf_and_words(filter1, filter2, 128, FUZ_SDBF_FILTER_SIZE);
+}
+
+// byte counts of the common bits of 32 bytes per step with the vpshufb nibble lookup
+__attribute__((target("avx2")))
+static inline __m256i fuz_sdbf_and_bytes_avx2(const uint8_t *filter1, const uint8_t *filter2, int begin, int end)
+{
+    const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                            0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i byte_counts = _mm256_setzero_si256();
+
+    for (int i = begin; i < end; i += 32) {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(filter1 + i)),
+                                     _mm256_loadu_si256((const __m256i *)(filter2 + i)));
+        __m256i lo = _mm256_and_si256(v, low_mask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+        byte_counts = _mm256_add_epi8(byte_counts, _mm256_shuffle_epi8(lookup, lo));
+        byte_counts = _mm256_add_epi8(byte_counts, _mm256_shuffle_epi8(lookup, hi));
+    }
+    return byte_counts;
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t fuz_sdbf_sum_bytes_avx2(__m256i byte_counts)
+{
+    __m256i sums = _mm256_sad_epu8(byte_counts, _mm256_setzero_si256());
+    return _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+         + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+}
+
+__attribute__((target("avx2")))
+static void fuz_sdbf_stages_avx2(const uint8_t *filter1, const uint8_t *filter2, uint32_t *stages)
+{
+    stages[0] = fuz_sdbf_sum_bytes_avx2(fuz_sdbf_and_bytes_avx2(filter1, filter2, 0, 32));
+    stages[1] = fuz_sdbf_sum_bytes_avx2(fuz_sdbf_and_bytes_avx2(filter1, filter2, 32, 64));
+    stages[2] = fuz_sdbf_sum_bytes_avx2(fuz_sdbf_and_bytes_avx2(filter1, filter2, 64, 128));
+    stages[3] = fuz_sdbf_sum_bytes_avx2(fuz_sdbf_and_bytes_avx2(filter1, filter2, 128, FUZ_SDBF_FILTER_SIZE));
+}
+
+// the first 64 bytes hold stages 0 and 1 in the low and high four 64-bit lanes
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void fuz_sdbf_stages_avx512(const uint8_t *filter1, const uint8_t *filter2, uint32_t *stages)
+{
+    __m512i v[4];
+    for (int i = 0; i < 4; i++) {
+        v[i] = _mm512_popcnt_epi64(_mm512_and_si512(_mm512_loadu_si512((const void *)(filter1 + 64*i)),
+                                                    _mm512_loadu_si512((const void *)(filter2 + 64*i))));
+    }
+    // the lanes are added in scalar code, the reduce and extract intrinsics of gcc 12 warn about uninitialized registers
+    alignas(64) uint64_t lanes[3][8];
+    _mm512_store_si512((void *)lanes[0], v[0]);
+    _mm512_store_si512((void *)lanes[1], v[1]);
+    _mm512_store_si512((void *)lanes[2], _mm512_add_epi64(v[2], v[3]));
+    stages[0] = lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3];
+    stages[1] = lanes[0][4] + lanes[0][5] + lanes[0][6] + lanes[0][7];
+    stages[2] = stages[3] = 0;
+    for (int i = 0; i < 8; i++) {
+        stages[2] += lanes[1][i];
+        stages[3] += lanes[2][i];
+    }
+}
+#endif
+
+// fastest stage kernel of the cpu, picked once
+struct fuz_sdbf_kernel {
+    fuz_sdbf_kernel() : stages(fuz_sdbf_stages_scalar), name("scalar")
+    {
+#ifdef FUZ_SDBF_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("popcnt")) {
+            stages = fuz_sdbf_stages_popcnt;
+            name = "popcnt";
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            stages = fuz_sdbf_stages_avx2;
+            name = "avx2";
+        }
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")) {
+            stages = fuz_sdbf_stages_avx512;
+            name = "avx512-vpopcntdq";
+        }
+#endif
+    }
+
+    fuz_sdbf_stage_kernel stages;
+    const char *name;
+};
+
+static const fuz_sdbf_kernel &fuz_sdbf_selected_kernel()
+{
+    static const fuz_sdbf_kernel kernel;
+    return kernel;
+}
+
+const char *fuz_sdbf_kernel_name()
+{
+    return fuz_sdbf_selected_kernel().name;
+}
+
+// sdhash's bf_match_est for two filters without common features: expected bits the filters share by chance
+static uint32_t fuz_sdbf_match_est(uint32_t s1, uint32_t s2)
+{
+    const uint32_t m = FUZ_SDBF_FILTER_BITS, k = FUZ_SDBF_HASH_COUNT;
+    const double ex = 1 - 1.0/m;
+    return (uint32_t)(m * (1 - pow(ex, k*s1) - pow(ex, k*s2) + pow(ex, k*(s1+s2))));
+}
+
+// fuz_sdbf_match_est for all element counts of sdhash-dd filters
+struct fuz_sdbf_estimates {
+    fuz_sdbf_estimates() : table(256 * 256)
+    {
+        for (uint32_t s1 = 0; s1 < 256; s1++) {
+            for (uint32_t s2 = 0; s2 < 256; s2++) table[s1 * 256 + s2] = fuz_sdbf_match_est(s1, s2);
+        }
+    }
+
+    uint32_t operator()(uint32_t s1, uint32_t s2) const
+    {
+        return s1 < 256 && s2 < 256 ? table[s1 * 256 + s2] : fuz_sdbf_match_est(s1, s2);
+    }
+
+    std::vector<uint32_t> table;
+};
+
+static uint32_t fuz_sdbf_min_est(uint32_t s1, uint32_t s2)
+{
+    static const fuz_sdbf_estimates estimates;
+    return estimates(s1, s2);
+}
+
+// sdbf_max_score's cut-off, computed in unsigned like sdhash so max_est < min_est gives a cut-off no filter reaches
+static inline uint32_t fuz_sdbf_cut_off(uint32_t max_est, uint32_t min_est)
+{
+    return (uint32_t)(0.3 * (double)(max_est - min_est) + (double)min_est);
+}
+
+static inline double fuz_sdbf_pair_score(uint32_t match, uint32_t max_est, uint32_t cut_off)
+{
+    return (match <= cut_off) ? 0 : (double)(match - cut_off) / (max_est - cut_off);
+}
+
+// bf_bitcount_cut_256 without slack, gives up with 0 when a part of the filter has too few common bits
+static inline uint32_t fuz_sdbf_bitcount_cut(const uint32_t *stages, uint32_t cut_off)
+{
+    uint32_t result = stages[0];
+    if (cut_off > 0 && 8 * result < cut_off) return 0;
+    result += stages[1];
+    if (cut_off > 0 && 4 * result < cut_off) return 0;
+    result += stages[2];
+    if (cut_off > 0 && 2 * result < cut_off) return 0;
+    return result + stages[3];
+}
+
+// sdbf_max_score of filter f1 against all filters of digest i2, -1 if no filter was compared
+static double fuz_sdbf_max_score(const fuz_sdbf_store &store1, size_t i1, uint32_t f1, const fuz_sdbf_store &store2, size_t i2)
+{
+    const fuz_sdbf_stage_kernel stage_kernel = fuz_sdbf_selected_kernel().stages;
+    const uint32_t s1 = store1.elem_counts[f1];
+    if (s1 < FUZ_SDBF_MIN_ELEM_COUNT) return 0;
+
+    double max_score = -1;
+    const uint32_t e1 = store1.hamming[f1];
+    const uint32_t end2 = store2.first_filter[i2] + store2.filter_count[i2];
+    for (uint32_t f2 = store2.first_filter[i2]; f2 < end2; f2++) {
+        const uint32_t s2 = store2.elem_counts[f2];
+        if (store1.filter_count[i1] > 1 && s2 < FUZ_SDBF_MIN_ELEM_COUNT) continue;
+
+        const uint32_t e2 = store2.hamming[f2];
+        const uint32_t max_est = std::min(e1, e2);
+        const uint32_t cut_off = fuz_sdbf_cut_off(max_est, fuz_sdbf_min_est(s1, s2));
+
+        uint32_t stages[FUZ_SDBF_STAGES];
+        stage_kernel(store1.filter(f1), store2.filter(f2), stages);
+        const double score = fuz_sdbf_pair_score(fuz_sdbf_bitcount_cut(stages, cut_off), max_est, cut_off);
+        max_score = (score > max_score) ? score : max_score;
+    }
+    return max_score;
+}
+
+// sdbf_score scores the digest with fewer filters against the other, ties go by the element count of the last filter
+// or the name, true if digest i2 is scored against digest i1
+static inline bool fuz_sdbf_swapped(const fuz_sdbf_store &store1, size_t i1, const fuz_sdbf_store &store2, size_t i2)
+{
+    const uint32_t count1 = store1.filter_count[i1], count2 = store2.filter_count[i2];
+    return count1 > count2 || (count1 == count2 &&
+           (store1.elem_counts[store1.first_filter[i1] + count1 - 1] > store2.elem_counts[store2.first_filter[i2] + count2 - 1] ||
+            strcmp(store1.name(i1), store2.name(i2)) > 0));
+}
+
+int32_t fuz_sdbf_score(const fuz_sdbf_store &store1, size_t i1, const fuz_sdbf_store &store2, size_t i2, int32_t threshold)
+{
+    // the single filter pairs of sdhash-dd blocks, the order of the pair only matters for a sparse filter or
+    // an estimate that rounds differently in the other order, the name is only compared then
+    if (store1.filter_count[i1] == 1 && store2.filter_count[i2] == 1) {
+        uint32_t f1 = store1.first_filter[i1], f2 = store2.first_filter[i2];
+        uint32_t s1 = store1.elem_counts[f1], s2 = store2.elem_counts[f2];
+        const fuz_sdbf_store *a = &store1, *b = &store2;
+        if (s1 < FUZ_SDBF_MIN_ELEM_COUNT || s2 < FUZ_SDBF_MIN_ELEM_COUNT || fuz_sdbf_min_est(s1, s2) != fuz_sdbf_min_est(s2, s1)) {
+            if (fuz_sdbf_swapped(store1, i1, store2, i2)) {
+                std::swap(a, b);
+                std::swap(f1, f2);
+                std::swap(s1, s2);
+            }
+            if (s1 < FUZ_SDBF_MIN_ELEM_COUNT) return 0;
+        }
+
+        const uint32_t max_est = std::min(a->hamming[f1], b->hamming[f2]);
+        const uint32_t cut_off = fuz_sdbf_cut_off(max_est, fuz_sdbf_min_est(s1, s2));
+
+        // bound by the segment popcounts before the common bits are counted
+        if (threshold >= 1) {
+            uint32_t bound = 0;
+            const uint16_t *segments1 = a->segment_counts(f1), *segments2 = b->segment_counts(f2);
+            for (int s = 0; s < FUZ_SDBF_SEGMENTS; s++) bound += std::min(segments1[s], segments2[s]);
+            if (bound <= cut_off || lround(100.0 * fuz_sdbf_pair_score(bound, max_est, cut_off)) < threshold) return 0;
+        }
+
+        uint32_t stages[FUZ_SDBF_STAGES];
+        fuz_sdbf_selected_kernel().stages(a->filter(f1), b->filter(f2), stages);
+        return lround(100.0 * fuz_sdbf_pair_score(fuz_sdbf_bitcount_cut(stages, cut_off), max_est, cut_off));
+    }
+
+    const fuz_sdbf_store *a = &store1, *b = &store2;
+    size_t ia = i1, ib = i2;
+    if (fuz_sdbf_swapped(store1, i1, store2, i2)) {
+        std::swap(a, b);
+        std::swap(ia, ib);
+    }
+
+    double score_sum = -1;
+    uint32_t sparse = 0;
+    const uint32_t count = a->filter_count[ia];
+    for (uint32_t f = a->first_filter[ia]; f < a->first_filter[ia] + count; f++) {
+        const double max_score = fuz_sdbf_max_score(*a, ia, f, *b, ib);
+        score_sum = (score_sum < 0) ? max_score : score_sum + max_score;
+        if (a->elem_counts[f] < FUZ_SDBF_MIN_ELEM_COUNT) sparse++;
+    }
+
+    uint32_t denom = count;
+    if (count > 1) denom -= sparse;
+    if (denom == 0) score_sum = -1;
+    return (score_sum < 0) ? -1 : lround(100.0 * score_sum / denom);
+}
+
+// base64 as written by sdhash's b64encode
+static bool fuz_sdbf_b64decode(const char *in, size_t length, uint8_t *out, size_t out_length)
+{
+    size_t n = 0;
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (size_t i = 0; i < length && in[i] != '='; i++) {
+        const char c = in[i];
+        uint32_t v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '+') v = 62;
+        else if (c == '/') v = 63;
+        else return false;
+
+        buffer = (buffer << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n == out_length) return false;
+            out[n++] = (buffer >> bits) & 0xff;
+        }
+    }
+    return n == out_length;
+}
+
+fuz_sdbf_store::fuz_sdbf_store()
+    : first_filter(), filter_count(), name_offset(), names(), filters(NULL), filter_total(0), filter_capacity(0),
+      elem_counts(), hamming(), segments()
+{
+}
+
+fuz_sdbf_store::~fuz_sdbf_store()
+{
+    free(filters);
+}
+
+bool fuz_sdbf_store::add(const std::string &digest)
+{
+    // sdbf-dd:03:<name length>:<name>:<size>:sha1:<filter size>:<hash count>:<mask>:<max elements>:<filters>:<dd block size>
+    // followed by :<element count>:<base64 filter> for every filter, the name can contain the delimiter
+    const char *magic = "sdbf-dd:";
+    if (digest.compare(0, strlen(magic), magic) != 0) return false;
+
+    size_t pos = strlen(magic);
+    auto field = [&](std::string &out) {
+        if (pos > digest.length()) return false;
+        size_t end = digest.find(':', pos);
+        if (end == std::string::npos) end = digest.length();
+        out = digest.substr(pos, end - pos);
+        pos = end + 1;
+        return true;
+    };
+
+    std::string version, name_length;
+    if (!field(version) || !field(name_length)) return false;
+    const size_t name_end = pos + strtoul(name_length.c_str(), NULL, 10);
+    if (name_end >= digest.length() || digest[name_end] != ':') return false;
+    const std::string name = digest.substr(pos, name_end - pos);
+    pos = name_end + 1;
+
+    std::string size, hash, filter_size, hash_count, mask, max_elem, count, dd_block_size;
+    if (!field(size) || !field(hash) || !field(filter_size) || !field(hash_count) || !field(mask) ||
+        !field(max_elem) || !field(count) || !field(dd_block_size)) return false;
+    if (atoi(filter_size.c_str()) != FUZ_SDBF_FILTER_SIZE || atoi(hash_count.c_str()) != FUZ_SDBF_HASH_COUNT) return false;
+
+    const long n = atol(count.c_str());
+    if (n <= 0) return false;
+
+    // the arena doubles, so loading a hashfile copies every filter about twice
+    if (filter_total + n > filter_capacity) {
+        filter_capacity = std::max<size_t>(std::max<size_t>(2 * filter_capacity, 64), filter_total + n);
+        void *grown = NULL;
+        if (posix_memalign(&grown, FUZ_SDBF_ARENA_ALIGN, filter_capacity * FUZ_SDBF_FILTER_SIZE) != 0) {
+            std::cerr << "Malloc error\n";
+            exit(1);
+        }
+        if (filter_total) memcpy(grown, filters, filter_total * FUZ_SDBF_FILTER_SIZE);
+        free(filters);
+        filters = (uint8_t *)grown;
+    }
+
+    const size_t first = filter_total;
+    for (long f = 0; f < n; f++) {
+        std::string elem_count, filter;
+        if (!field(elem_count) || !field(filter)) break;
+        uint8_t *out = filters + (first + f) * FUZ_SDBF_FILTER_SIZE;
+        if (!fuz_sdbf_b64decode(filter.data(), filter.length(), out, FUZ_SDBF_FILTER_SIZE)) break;
+        elem_counts.push_back(strtoul(elem_count.c_str(), NULL, 16));
+    }
+    if (elem_counts.size() != first + n) {
+        elem_counts.resize(first);
+        return false;
+    }
+
+    for (long f = 0; f < n; f++) {
+        const uint8_t *filter = filters + (first + f) * FUZ_SDBF_FILTER_SIZE;
+        uint16_t bits = 0;
+        for (int s = 0; s < FUZ_SDBF_SEGMENTS; s++) {
+            const int segment_size = FUZ_SDBF_FILTER_SIZE / FUZ_SDBF_SEGMENTS;
+            const uint16_t segment = fuz_sdbf_and_words(filter, filter, s * segment_size, (s + 1) * segment_size);
+            segments.push_back(segment);
+            bits += segment;
+        }
+        hamming.push_back(bits);
+    }
+
+    filter_total += n;
+    first_filter.push_back(first);
+    filter_count.push_back(n);
+    name_offset.push_back(names.size());
+    names.append(name.c_str(), name.length() + 1);
+    return true;
+}
@@ -0,0 +1,123 @@
+/**
+ *
+ * fuz_sdhash:
+ *
+ * Candidate search and scoring over sdhash bloom filters
+ */
+
+#ifndef FUZ_SDHASH_H
+#define FUZ_SDHASH_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fuz_index.h"
+
+// sdhash bloom filters are 256 bytes
+#define FUZ_SDBF_FILTER_SIZE 256
+#define FUZ_SDBF_FILTER_BITS (FUZ_SDBF_FILTER_SIZE * 8)
+
+// upper limit of MinHash values per filter (rows * bands)
+#define FUZ_LSH_MAX_HASHES 256
+
+// Jaccard similarity of the set bits of two filters with bits_small and bits_large bits set when they just
+// reach threshold in sdhash's score, the cut-off uses the expected random overlap of the filters as minimum estimate
+double fuz_lsh_jaccard(int threshold, int bits_small, int bits_large);
+
+// banded MinHash over the positions of the set bits in sdhash bloom filters
+// two filters become candidates if all MinHash values of at least one band are equal
+struct fuz_lsh_index {
+    fuz_lsh_index();
+
+    // picks the most selective rows per band that still find filters with the given Jaccard similarity with probability recall
+    void configure(double jaccard, double recall);
+    void add(uint32_t ref, const uint8_t *filter);
+    // sorts the band tables, has to be called before candidates
+    void finalize();
+    // appends all refs sharing a band with the filter, refs can repeat
+    void candidates(const uint8_t *filter, std::vector<uint32_t> &refs) const;
+
+    // probability that two filters with the given Jaccard similarity become candidates
+    double recall(double jaccard) const;
+
+    uint32_t rows;
+    uint32_t bands;
+
+private:
+    // false for filters without bits set, they are never indexed
+    bool band_keys(const uint8_t *filter, uint64_t *keys) const;
+
+    // ranks[bit * hashes + k] is the position of bit in permutation k
+    std::vector<uint16_t> ranks;
+    // per band sorted (key, ref) pairs
+    std::vector<std::vector<std::pair<uint64_t, uint32_t> > > tables;
+};
+
+// sdhash-dd digests hash every feature 5 times, filters with less than 16 features are sparse
+#define FUZ_SDBF_HASH_COUNT 5
+#define FUZ_SDBF_MIN_ELEM_COUNT 16
+
+// bf_bitcount_cut_256 checks its cut-off after 1/8, 1/4 and 1/2 of a filter, the plugin scorer counts these
+// FUZ_SDBF_STAGES parts in one pass, FUZ_SDBF_SEGMENTS equal parts bound the bits two filters have in common
+#define FUZ_SDBF_STAGES 4
+#define FUZ_SDBF_SEGMENTS 8
+
+// filters of the flat store are aligned for the vector kernels
+#define FUZ_SDBF_ARENA_ALIGN 64
+
+// flat copy of sdhash-dd digests for the plugin scorer, the filters of all digests are kept in one aligned arena
+struct fuz_sdbf_store {
+    fuz_sdbf_store();
+    ~fuz_sdbf_store();
+    fuz_sdbf_store(const fuz_sdbf_store &) = delete;
+    fuz_sdbf_store &operator=(const fuz_sdbf_store &) = delete;
+
+    // parses an sdhash-dd digest as written by sdbf::to_string, false for other digests
+    bool add(const std::string &digest);
+
+    size_t size() const { return first_filter.size(); }
+    const char *name(size_t i) const { return names.data() + name_offset[i]; }
+    const uint8_t *filter(size_t f) const { return filters + f * FUZ_SDBF_FILTER_SIZE; }
+    const uint16_t *segment_counts(size_t f) const { return segments.data() + f * FUZ_SDBF_SEGMENTS; }
+
+    // per digest
+    std::vector<uint32_t> first_filter;
+    std::vector<uint32_t> filter_count;
+    std::vector<uint32_t> name_offset;
+    std::string names;
+
+    // per filter
+    uint8_t *filters;
+    size_t filter_total;
+    size_t filter_capacity;
+    std::vector<uint16_t> elem_counts;
+    std::vector<uint16_t> hamming;
+    std::vector<uint16_t> segments;
+};
+
+// sdbf_score of digest i1 against digest i2 without sampling, the same as sdbf::compare
+// with threshold >= 1 a single filter pair that cannot reach it returns 0 without counting its common bits
+int32_t fuz_sdbf_score(const fuz_sdbf_store &store1, size_t i1, const fuz_sdbf_store &store2, size_t i2, int32_t threshold);
+
+// name of the common bits kernel selected for the cpu
+const char *fuz_sdbf_kernel_name();
+
+// counters of the verify scorer, reported at shutdown
+struct fuz_sdbf_scorer_stats {
+    std::atomic<uint64_t> pairs{0};
+    std::atomic<uint64_t> mismatches{0};
+};
+
+// size of the sdhash feature index in bytes, holds about 50 million features with 1% false positives
+#define FUZ_SDHASH_INDEX_SIZE (64 * 1024 * 1024)
+
+// counters of the query blocks checked against the sdhash feature index, reported at shutdown
+struct fuz_sdhash_index_stats {
+    std::atomic<uint64_t> blocks{0};
+    std::atomic<uint64_t> rejected{0};
+};
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ *
+ * fuz_simhash:
+ *
+ * 64-bit SimHash side signatures and multi-index Hamming search
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "fuz_chunks.h"
+#include "fuz_simhash.h"
+
+// MurmurHash3 finalizer, spreads the FNV chunk hashes over all 64 bits before voting
+static inline uint64_t fuz_simhash_mix(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+uint64_t fuz_simhash_signature(const unsigned char *buf, size_t length)
+{
+    std::vector<uint64_t> hashes;
+    fuz_chunk_hashes(buf, length, hashes);
+    fuz_chunk_distinct(hashes);
+
+    int32_t votes[64] = {0};
+    for (uint64_t hash : hashes) {
+        const uint64_t mixed = fuz_simhash_mix(hash);
+        for (int b = 0; b < 64; b++) votes[b] += ((mixed >> b) & 1) ? 1 : -1;
+    }
+
+    uint64_t signature = 0;
+    for (int b = 0; b < 64; b++) {
+        if (votes[b] > 0) signature |= (uint64_t)1 << b;
+    }
+    return signature;
+}
+
+std::string fuz_simhash_to_string(uint64_t signature)
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string out(FUZ_SIMHASH_HEX_LENGTH, '0');
+    for (int i = 0; i < FUZ_SIMHASH_HEX_LENGTH; i++) {
+        out[FUZ_SIMHASH_HEX_LENGTH - 1 - i] = hex[(signature >> (4 * i)) & 0xf];
+    }
+    return out;
+}
+
+bool fuz_simhash_parse(const std::string &line, uint64_t &signature, std::string &name)
+{
+    const size_t prefix = strlen(FUZ_SIMHASH_PREFIX);
+    if (line.compare(0, prefix, FUZ_SIMHASH_PREFIX) != 0) return false;
+    if (line.length() < prefix + FUZ_SIMHASH_HEX_LENGTH + 1 || line[prefix + FUZ_SIMHASH_HEX_LENGTH] != ':') return false;
+
+    signature = 0;
+    for (int i = 0; i < FUZ_SIMHASH_HEX_LENGTH; i++) {
+        const char c = line[prefix + i];
+        uint64_t v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else return false;
+        signature = (signature << 4) | v;
+    }
+
+    name = line.substr(prefix + FUZ_SIMHASH_HEX_LENGTH + 1);
+    return true;
+}
+
+fuz_simhash_index::fuz_simhash_index(uint32_t max_distance)
+    : radius(max_distance), count(0), entries(), offsets(), signatures(), refs()
+{
+}
+
+void fuz_simhash_index::finalize()
+{
+    const uint32_t keys = 1u << FUZ_SIMHASH_KEY_BITS;
+    count = entries.size();
+
+    // counting sort of the entries by the key of every table
+    for (int t = 0; t < FUZ_SIMHASH_TABLES; t++) {
+        const int shift = t * FUZ_SIMHASH_KEY_BITS;
+        std::vector<uint32_t> &offset = offsets[t];
+        offset.assign(keys + 1, 0);
+        for (auto &entry : entries) offset[((entry.first >> shift) & (keys - 1)) + 1]++;
+        for (uint32_t k = 0; k < keys; k++) offset[k + 1] += offset[k];
+
+        std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+        signatures[t].resize(count);
+        refs[t].resize(count);
+        for (auto &entry : entries) {
+            const uint32_t at = fill[(entry.first >> shift) & (keys - 1)]++;
+            signatures[t][at] = entry.first;
+            refs[t][at] = entry.second;
+        }
+    }
+    std::vector<std::pair<uint64_t, uint32_t> >().swap(entries);
+}
+
+void fuz_simhash_index::probe(int t, uint32_t key, uint32_t flips, int from, uint64_t signature, std::vector<uint32_t> &out) const
+{
+    for (uint32_t i = offsets[t][key]; i < offsets[t][key + 1]; i++) {
+        if ((uint32_t)__builtin_popcountll(signatures[t][i] ^ signature) <= radius) out.push_back(refs[t][i]);
+    }
+    if (flips == 0) return;
+    for (int b = from; b < FUZ_SIMHASH_KEY_BITS; b++) {
+        probe(t, key ^ (1u << b), flips - 1, b + 1, signature, out);
+    }
+}
+
+void fuz_simhash_index::candidates(uint64_t signature, std::vector<uint32_t> &out) const
+{
+    // pigeonhole: a signature within radius matches at least one key within radius / FUZ_SIMHASH_TABLES bits
+    const uint32_t flips = radius / FUZ_SIMHASH_TABLES;
+
+    out.clear();
+    if (count == 0) return;
+    for (int t = 0; t < FUZ_SIMHASH_TABLES; t++) {
+        const uint32_t key = (signature >> (t * FUZ_SIMHASH_KEY_BITS)) & ((1u << FUZ_SIMHASH_KEY_BITS) - 1);
+        probe(t, key, flips, 0, signature, out);
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
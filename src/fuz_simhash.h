@@ -0,0 +1,62 @@
+/**
+ *
+ * fuz_simhash:
+ *
+ * 64-bit SimHash side signatures and multi-index Hamming search
+ */
+
+#ifndef FUZ_SIMHASH_H
+#define FUZ_SIMHASH_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fuz_index.h"
+
+// import files keep the signatures in comment lines "#fuz_simhash:<16 hex digits>:<block name>"
+#define FUZ_SIMHASH_PREFIX "#fuz_simhash:"
+#define FUZ_SIMHASH_HEX_LENGTH 16
+
+// the signature is split into FUZ_SIMHASH_TABLES keys of FUZ_SIMHASH_KEY_BITS bits, two signatures within
+// radius r differ in at most r / FUZ_SIMHASH_TABLES bits of at least one key
+#define FUZ_SIMHASH_TABLES 4
+#define FUZ_SIMHASH_KEY_BITS 16
+#define FUZ_SIMHASH_MAX_RADIUS 15
+
+// SimHash over the distinct mrshv2 chunk hashes of a block
+uint64_t fuz_simhash_signature(const unsigned char *buf, size_t length);
+std::string fuz_simhash_to_string(uint64_t signature);
+// parses a signature line, false for other lines
+bool fuz_simhash_parse(const std::string &line, uint64_t &signature, std::string &name);
+
+// multi-index hashing table over the imported signatures, refs are the positions of the blocks
+// in the imported similarity hash set
+struct fuz_simhash_index {
+    explicit fuz_simhash_index(uint32_t max_distance);
+
+    void add(uint64_t signature, uint32_t ref) { entries.push_back(std::make_pair(signature, ref)); }
+    // builds the tables, has to be called before candidates
+    void finalize();
+    // sorted refs with a signature within the radius
+    void candidates(uint64_t signature, std::vector<uint32_t> &out) const;
+
+    size_t size() const { return count; }
+
+    const uint32_t radius;
+
+private:
+    // appends the refs of table t under key and all keys that differ from it in up to flips more bits at positions >= from
+    void probe(int t, uint32_t key, uint32_t flips, int from, uint64_t signature, std::vector<uint32_t> &out) const;
+
+    size_t count;
+    // (signature, ref) pairs until finalize
+    std::vector<std::pair<uint64_t, uint32_t> > entries;
+    // per table: key k owns [offsets[t][k], offsets[t][k+1]) of signatures[t] and refs[t]
+    std::vector<uint32_t> offsets[FUZ_SIMHASH_TABLES];
+    std::vector<uint64_t> signatures[FUZ_SIMHASH_TABLES];
+    std::vector<uint32_t> refs[FUZ_SIMHASH_TABLES];
+};
+
+#endif
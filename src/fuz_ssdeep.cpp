@@ -0,0 +1,324 @@
+/**
+ *
+ * fuz_ssdeep:
+ *
+ * Parsed ssdeep digests, scoring and candidate search
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include "fuz_ssdeep.h"
+
+// copies a digest part up to stop, at most 3 equal characters in a row, like copy_eliminate_sequences of fuzzy.c
+static bool fuz_eliminate_sequences(const char *&in, char stop, char *out, uint8_t &length)
+{
+    size_t seq = 0;
+    length = 0;
+    for (; *in && *in != stop; in++) {
+        if (length && *in == out[length - 1]) {
+            if (++seq >= 3) continue;
+        } else {
+            seq = 0;
+        }
+        if (length == FUZ_SSDEEP_SPAMSUM_LENGTH) return false;
+        out[length++] = *in;
+    }
+    return true;
+}
+
+// the 7 characters at s as one integer, equal grams have equal values
+static inline uint64_t fuz_gram(const char *s)
+{
+    uint64_t gram = 0;
+    memcpy(&gram, s, FUZ_SSDEEP_ROLLING_WINDOW);
+    return gram;
+}
+
+bool fuz_ssdeep_parse(const char *text, fuz_ssdeep_digest &digest)
+{
+    char *end = NULL;
+    memset(&digest, 0, sizeof(digest));
+
+    // fuzzy_compare handles huge block sizes differently, ssdeep scores them itself
+    digest.block_size = strtoul(text, &end, 10);
+    if (end == text || *end != ':' || digest.block_size > ULONG_MAX / 2) return false;
+
+    const char *p = end + 1;
+    if (!fuz_eliminate_sequences(p, ':', digest.part[0], digest.length[0]) || *p != ':') return false;
+    p++;
+    if (!fuz_eliminate_sequences(p, ',', digest.part[1], digest.length[1])) return false;
+
+    fuz_ssdeep_prepare(digest);
+    digest.valid = true;
+    return true;
+}
+
+// position of a character in the base64 alphabet, FUZ_SSDEEP_ALPHABET for other characters
+struct fuz_ssdeep_alphabet {
+    fuz_ssdeep_alphabet() : index()
+    {
+        static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int c = 0; c < 256; c++) index[c] = FUZ_SSDEEP_ALPHABET;
+        for (int i = 0; i < FUZ_SSDEEP_ALPHABET; i++) index[(unsigned char)b64[i]] = i;
+    }
+
+    uint8_t operator()(char c) const { return index[(unsigned char)c]; }
+
+    uint8_t index[256];
+};
+
+static const fuz_ssdeep_alphabet fuz_alphabet;
+
+void fuz_ssdeep_prepare(fuz_ssdeep_digest &digest)
+{
+    for (int k = 0; k < 2; k++) {
+        for (int i = 0; i + FUZ_SSDEEP_ROLLING_WINDOW <= digest.length[k]; i++) digest.grams[k][i] = fuz_gram(digest.part[k] + i);
+
+        digest.base64[k] = true;
+        for (int c = 0; c <= FUZ_SSDEEP_ALPHABET; c++) digest.masks[k][c] = 0;
+        for (int i = 0; i < digest.length[k]; i++) {
+            const uint8_t c = fuz_alphabet(digest.part[k][i]);
+            if (c == FUZ_SSDEEP_ALPHABET) digest.base64[k] = false;
+            else digest.masks[k][c] |= (uint64_t)1 << i;
+        }
+    }
+}
+
+// has_common_substring of fuzzy.c against the precomputed 7-grams of d2
+static bool fuz_common_substring(const char *s1, uint32_t s1len, const fuz_ssdeep_digest &d2, int k2)
+{
+    const int n1 = s1len - FUZ_SSDEEP_ROLLING_WINDOW + 1;
+    const int n2 = d2.length[k2] - FUZ_SSDEEP_ROLLING_WINDOW + 1;
+
+    for (int i = 0; i < n1; i++) {
+        const uint64_t gram = fuz_gram(s1 + i);
+        for (int j = 0; j < n2; j++) {
+            if (d2.grams[k2][j] == gram) return true;
+        }
+    }
+    return false;
+}
+
+// edit_distn of ssdeep: insert and remove cost 1, replace cost 2
+static int fuz_edit_distance(const char *s1, int s1len, const char *s2, int s2len)
+{
+    int row[2][FUZ_SSDEEP_SPAMSUM_LENGTH + 1];
+    int *prev = row[0], *curr = row[1];
+
+    for (int i2 = 0; i2 <= s2len; i2++) prev[i2] = i2;
+    for (int i1 = 0; i1 < s1len; i1++) {
+        curr[0] = i1 + 1;
+        for (int i2 = 0; i2 < s2len; i2++) {
+            int cost = std::min(prev[i2 + 1] + 1, curr[i2] + 1);
+            curr[i2 + 1] = std::min(cost, prev[i2] + (s1[i1] == s2[i2] ? 0 : 2));
+        }
+        std::swap(prev, curr);
+    }
+    return prev[s2len];
+}
+
+// a replace costs as much as a remove and an insert, so edit_distn is s1len + s2len - 2 * the longest common subsequence
+// the subsequence is counted bit-parallel (Hyyro): v has a 0 for every character of the masked part that is matched
+static inline uint32_t fuz_lcs(const uint64_t *masks, uint32_t length, const char *s, uint32_t s_length)
+{
+    uint64_t v = ~(uint64_t)0;
+    for (uint32_t i = 0; i < s_length; i++) {
+        const uint64_t u = v & masks[fuz_alphabet(s[i])];
+        v = (v + u) | (v - u);
+    }
+    const uint64_t used = (length == 64) ? ~(uint64_t)0 : (((uint64_t)1 << length) - 1);
+    return __builtin_popcountll(~v & used);
+}
+
+// edit_distn of s1 and part k2 of d2
+static inline uint32_t fuz_distance(const char *s1, uint32_t s1len, const fuz_ssdeep_digest &d2, int k2)
+{
+    const uint32_t s2len = d2.length[k2];
+    if (!d2.base64[k2]) return fuz_edit_distance(s1, s1len, d2.part[k2], s2len);
+    return s1len + s2len - 2 * fuz_lcs(d2.masks[k2], s2len, s1, s1len);
+}
+
+// score_strings of fuzzy.c after the edit distance
+static uint32_t fuz_distance_score(uint32_t distance, uint32_t s1len, uint32_t s2len, unsigned long block_size)
+{
+    uint32_t score = (distance * FUZ_SSDEEP_SPAMSUM_LENGTH) / (s1len + s2len);
+    score = (100 * score) / FUZ_SSDEEP_SPAMSUM_LENGTH;
+    if (score >= 100) return 0;
+    score = 100 - score;
+
+    // small block sizes do not exaggerate the match
+    if (block_size >= (99 + FUZ_SSDEEP_ROLLING_WINDOW) / FUZ_SSDEEP_ROLLING_WINDOW * FUZ_SSDEEP_MIN_BLOCKSIZE) return score;
+    if (score > block_size / FUZ_SSDEEP_MIN_BLOCKSIZE * std::min(s1len, s2len)) {
+        score = block_size / FUZ_SSDEEP_MIN_BLOCKSIZE * std::min(s1len, s2len);
+    }
+    return score;
+}
+
+// score_strings of fuzzy.c for s1 and part k2 of d2, the score does not depend on the order of the parts
+static uint32_t fuz_score_parts(const char *s1, uint32_t s1len, const fuz_ssdeep_digest &d2, int k2, unsigned long block_size)
+{
+    if (s1len < FUZ_SSDEEP_ROLLING_WINDOW || d2.length[k2] < FUZ_SSDEEP_ROLLING_WINDOW) return 0;
+    if (!fuz_common_substring(s1, s1len, d2, k2)) return 0;
+    return fuz_distance_score(fuz_distance(s1, s1len, d2, k2), s1len, d2.length[k2], block_size);
+}
+
+// fuzzy_compare of a digest given by its parts and a parsed digest d2
+static int fuz_compare_parts(unsigned long bs1, const uint8_t *length1, const char *part10, const char *part11, const fuz_ssdeep_digest &d2)
+{
+    const unsigned long bs2 = d2.block_size;
+
+    // block sizes have to be equal or a factor of 2 apart
+    if (bs1 != bs2 && bs1 * 2 != bs2 && (bs1 % 2 == 1 || bs1 / 2 != bs2)) return 0;
+
+    if (bs1 == bs2 && length1[0] == d2.length[0] && length1[1] == d2.length[1] &&
+        memcmp(part10, d2.part[0], length1[0]) == 0 && memcmp(part11, d2.part[1], length1[1]) == 0) return 100;
+
+    if (bs1 == bs2) {
+        return std::max(fuz_score_parts(part10, length1[0], d2, 0, bs1), fuz_score_parts(part11, length1[1], d2, 1, bs1 * 2));
+    } else if (bs1 * 2 == bs2) {
+        return fuz_score_parts(part11, length1[1], d2, 0, bs2);
+    } else {
+        return fuz_score_parts(part10, length1[0], d2, 1, bs1);
+    }
+}
+
+int fuz_ssdeep_compare(const fuz_ssdeep_digest &d1, const fuz_ssdeep_digest &d2)
+{
+    return fuz_compare_parts(d1.block_size, d1.length, d1.part[0], d1.part[1], d2);
+}
+
+fuz_ssdeep_store::fuz_ssdeep_store()
+    : block_sizes(), valid(), offsets(1, 0), packed(), name_offset(), names()
+{
+}
+
+void fuz_ssdeep_store::add(const char *hash, const std::string &name)
+{
+    fuz_ssdeep_digest digest;
+    if (fuz_ssdeep_parse(hash, digest)) {
+        packed.push_back((char)digest.length[0]);
+        packed.push_back((char)digest.length[1]);
+        packed.append(digest.part[0], digest.length[0]);
+        packed.append(digest.part[1], digest.length[1]);
+        block_sizes.push_back(digest.block_size);
+        valid.push_back(1);
+    } else {
+        packed.append(hash);
+        block_sizes.push_back(0);
+        valid.push_back(0);
+    }
+    offsets.push_back(packed.size());
+    name_offset.push_back(names.size());
+    names.append(name.c_str(), name.length() + 1);
+}
+
+int fuz_ssdeep_store::compare(size_t i, const fuz_ssdeep_digest &digest) const
+{
+    const char *p = packed.data() + offsets[i];
+    const uint8_t length[2] = {(uint8_t)p[0], (uint8_t)p[1]};
+    return fuz_compare_parts(block_sizes[i], length, p + 2, p + 2 + length[0], digest);
+}
+
+std::string fuz_ssdeep_store::text(size_t i) const
+{
+    const char *p = packed.data() + offsets[i];
+    if (!valid[i]) return std::string(p, offsets[i + 1] - offsets[i]);
+
+    // the parts without their long sequences, fuzzy_compare removes them anyway
+    const uint8_t length0 = p[0], length1 = p[1];
+    return std::to_string(block_sizes[i]) + ":" + std::string(p + 2, length0) + ":" + std::string(p + 2 + length0, length1);
+}
+
+bool fuz_ssdeep_store::unpack(size_t i, fuz_ssdeep_digest &digest) const
+{
+    memset(&digest, 0, sizeof(digest));
+    if (!valid[i]) return false;
+
+    const char *p = packed.data() + offsets[i];
+    digest.block_size = block_sizes[i];
+    digest.length[0] = p[0];
+    digest.length[1] = p[1];
+    memcpy(digest.part[0], p + 2, digest.length[0]);
+    memcpy(digest.part[1], p + 2 + digest.length[0], digest.length[1]);
+    fuz_ssdeep_prepare(digest);
+    digest.valid = true;
+    return true;
+}
+
+size_t fuz_ssdeep_store::bytes() const
+{
+    return block_sizes.size() * sizeof(unsigned long) + valid.size() + offsets.size() * sizeof(uint32_t) + packed.size() +
+           name_offset.size() * sizeof(uint32_t) + names.size();
+}
+
+static uint64_t fuz_mix(uint64_t h, uint64_t v)
+{
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h * 0xff51afd7ed558ccdULL;
+}
+
+static uint64_t fuz_string_key(uint64_t h, const char *s, size_t length)
+{
+    for (size_t i = 0; i < length; i++) h = fuz_mix(h, (unsigned char)s[i]);
+    return h;
+}
+
+// calls fn(key) for every 7-gram of both parts, part 0 has the block size, part 1 twice the block size
+template <class F> static void fuz_for_each_gram(const fuz_ssdeep_digest &digest, F fn)
+{
+    for (int k = 0; k < 2; k++) {
+        const uint64_t seed = fuz_mix(0, digest.block_size << k);
+        for (int i = 0; i + FUZ_SSDEEP_ROLLING_WINDOW <= digest.length[k]; i++) {
+            fn(fuz_string_key(seed, digest.part[k] + i, FUZ_SSDEEP_ROLLING_WINDOW));
+        }
+    }
+}
+
+static uint64_t fuz_exact_key(const fuz_ssdeep_digest &digest)
+{
+    uint64_t h = fuz_mix(1, digest.block_size);
+    h = fuz_string_key(fuz_mix(h, digest.length[0]), digest.part[0], digest.length[0]);
+    return fuz_string_key(fuz_mix(h, digest.length[1]), digest.part[1], digest.length[1]);
+}
+
+fuz_ssdeep_gram_index::fuz_ssdeep_gram_index()
+    : grams(), exact(), unparsed(), ref_count(0)
+{
+}
+
+void fuz_ssdeep_gram_index::add(uint32_t ref, const fuz_ssdeep_digest &digest)
+{
+    ref_count++;
+    if (!digest.valid) {
+        unparsed.push_back(ref);
+        return;
+    }
+
+    exact.add(fuz_exact_key(digest), ref);
+    fuz_for_each_gram(digest, [&](uint64_t key) { grams.add(key, ref); });
+}
+
+void fuz_ssdeep_gram_index::finalize()
+{
+    grams.finalize();
+    exact.finalize();
+}
+
+void fuz_ssdeep_gram_index::candidates(const fuz_ssdeep_digest &digest, std::vector<uint32_t> &refs) const
+{
+    if (!digest.valid) {
+        refs.resize(ref_count);
+        for (size_t r = 0; r < ref_count; r++) refs[r] = r;
+        return;
+    }
+
+    refs = unparsed;
+    exact.lookup(fuz_exact_key(digest), refs);
+    fuz_for_each_gram(digest, [&](uint64_t key) { grams.lookup(key, refs); });
+
+    std::sort(refs.begin(), refs.end());
+    refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+}
@@ -0,0 +1,104 @@
+/**
+ *
+ * fuz_ssdeep:
+ *
+ * Parsed ssdeep digests, scoring and candidate search
+ */
+
+#ifndef FUZ_SSDEEP_H
+#define FUZ_SSDEEP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fuz_index.h"
+
+// ssdeep constants of fuzzy.c
+#define FUZ_SSDEEP_SPAMSUM_LENGTH 64
+#define FUZ_SSDEEP_ROLLING_WINDOW 7
+#define FUZ_SSDEEP_MIN_BLOCKSIZE 3
+#define FUZ_SSDEEP_MAX_GRAMS (FUZ_SSDEEP_SPAMSUM_LENGTH - FUZ_SSDEEP_ROLLING_WINDOW + 1)
+
+// digests are written in base64, masks[k][FUZ_SSDEEP_ALPHABET] stands for all other characters and is always 0
+#define FUZ_SSDEEP_ALPHABET 64
+
+// digest as fuzzy_compare sees it, parsed once instead of for every pair
+// part[0] has the block size, part[1] twice the block size, both with sequences longer than 3 reduced to 3 characters
+// grams[k][i] holds the 7 characters at position i of part k
+// bit i of masks[k][c] is set if character i of part k is base64 character c, for the bit-parallel edit distance
+struct fuz_ssdeep_digest {
+    unsigned long block_size;
+    uint8_t length[2];
+    char part[2][FUZ_SSDEEP_SPAMSUM_LENGTH];
+    uint64_t grams[2][FUZ_SSDEEP_MAX_GRAMS];
+    uint64_t masks[2][FUZ_SSDEEP_ALPHABET + 1];
+    // false if part k has characters outside base64, its edit distances are computed with the full table
+    bool base64[2];
+    // false if fuzzy_compare has to score the text itself (malformed digest or huge block size)
+    bool valid;
+};
+
+// fills the parsed digest, returns digest.valid
+bool fuz_ssdeep_parse(const char *text, fuz_ssdeep_digest &digest);
+// fills the grams and masks from the parts
+void fuz_ssdeep_prepare(fuz_ssdeep_digest &digest);
+
+// same score as fuzzy_compare for two valid digests
+int fuz_ssdeep_compare(const fuz_ssdeep_digest &digest1, const fuz_ssdeep_digest &digest2);
+
+// imported digests packed without their grams: the block sizes are kept apart, the lengths and reduced parts of
+// a digest follow each other in one string, names are in a separate table that comparisons do not touch
+struct fuz_ssdeep_store {
+    fuz_ssdeep_store();
+
+    // digests the parser rejects are kept as text for fuzzy_compare
+    void add(const char *hash, const std::string &name);
+
+    size_t size() const { return block_sizes.size(); }
+    const char *name(size_t i) const { return names.data() + name_offset[i]; }
+    bool parsed(size_t i) const { return valid[i] != 0; }
+
+    // same score as fuz_ssdeep_compare of digest i and a valid digest
+    int compare(size_t i, const fuz_ssdeep_digest &digest) const;
+    // digest i as text for fuzzy_compare
+    std::string text(size_t i) const;
+    // digest i with its grams, false if it was not parsed
+    bool unpack(size_t i, fuz_ssdeep_digest &digest) const;
+    // memory of the store in bytes, without the capacity of its vectors
+    size_t bytes() const;
+
+    // per digest, digest i is packed[offsets[i], offsets[i+1]): length of part 0, length of part 1, part 0, part 1
+    std::vector<unsigned long> block_sizes;
+    std::vector<uint8_t> valid;
+    std::vector<uint32_t> offsets;
+    std::string packed;
+
+    // names, only read to report matches
+    std::vector<uint32_t> name_offset;
+    std::string names;
+};
+
+// inverted index of the 7-grams of both digest parts, keyed by the block size of the part
+// fuzzy_compare only scores above 0 if the block sizes fit and a pair of parts with the same block size
+// shares a 7-gram, or if both digests are identical
+struct fuz_ssdeep_gram_index {
+    fuz_ssdeep_gram_index();
+
+    void add(uint32_t ref, const fuz_ssdeep_digest &digest);
+    // builds the lookup tables, has to be called before candidates
+    void finalize();
+    // sorted refs that can score above 0 with the digest
+    void candidates(const fuz_ssdeep_digest &digest, std::vector<uint32_t> &refs) const;
+
+    size_t size() const { return ref_count; }
+
+private:
+    fuz_key_table grams;
+    fuz_key_table exact;
+    // digests the parser rejects are candidates of every query
+    std::vector<uint32_t> unparsed;
+    size_t ref_count;
+};
+
+#endif
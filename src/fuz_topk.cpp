@@ -0,0 +1,77 @@
+/**
+ *
+ * fuz_topk:
+ *
+ * Best matches per query block or per imported block
+ */
+
+#include "fuz_topk.h"
+
+std::vector<fuz_match> fuz_topk_matches(std::vector<fuz_match> matches, size_t k)
+{
+    if (k == 0) return matches;
+
+    auto better = [](const fuz_match &a, const fuz_match &b) {
+        return a.score > b.score || (a.score == b.score && a.ref < b.ref);
+    };
+    auto before = [](const fuz_match &a, const fuz_match &b) {
+        return a.ref < b.ref;
+    };
+
+    size_t kept = 0;
+    for (size_t begin = 0, end = 0; begin < matches.size(); begin = end) {
+        for (end = begin; end < matches.size() && matches[end].query == matches[begin].query; end++);
+        const size_t count = std::min(k, end - begin);
+        std::partial_sort(matches.begin() + begin, matches.begin() + begin + count, matches.begin() + end, better);
+        std::sort(matches.begin() + begin, matches.begin() + begin + count, before);
+        std::move(matches.begin() + begin, matches.begin() + begin + count, matches.begin() + kept);
+        kept += count;
+    }
+    matches.resize(kept);
+    return matches;
+}
+
+fuz_topk_refs::fuz_topk_refs(size_t refs, size_t k)
+    : count(k), mutex(), heaps(refs), kth(new std::atomic<int>[refs])
+{
+    for (size_t r = 0; r < refs; r++) kth[r].store(INT_MIN, std::memory_order_relaxed);
+}
+
+void fuz_topk_refs::add(const std::vector<fuz_match> &matches, const std::function<std::string(uint32_t)> &query_name)
+{
+    // ordered best first, so the worst kept entry is on top of each heap
+    auto better = [](const entry &a, const entry &b) {
+        return a.score > b.score || (a.score == b.score && a.query < b.query);
+    };
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &match : matches) {
+        std::vector<entry> &heap = heaps[match.ref];
+        entry e = {match.score, query_name(match.query)};
+        if (heap.size() < count) {
+            heap.push_back(e);
+            std::push_heap(heap.begin(), heap.end(), better);
+        } else if (better(e, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = e;
+            std::push_heap(heap.begin(), heap.end(), better);
+        } else {
+            continue;
+        }
+        if (heap.size() == count) kth[match.ref].store(heap.front().score, std::memory_order_relaxed);
+    }
+}
+
+void fuz_topk_refs::for_each(const std::function<void(uint32_t, const std::string &, int)> &visit) const
+{
+    auto better = [](const entry &a, const entry &b) {
+        return a.score > b.score || (a.score == b.score && a.query < b.query);
+    };
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (uint32_t r = 0; r < heaps.size(); r++) {
+        std::vector<entry> sorted(heaps[r]);
+        std::sort_heap(sorted.begin(), sorted.end(), better);
+        for (auto &e : sorted) visit(r, e.query, e.score);
+    }
+}
@@ -0,0 +1,79 @@
+/**
+ *
+ * fuz_topk:
+ *
+ * Best matches per query block or per imported block
+ */
+
+#ifndef FUZ_TOPK_H
+#define FUZ_TOPK_H
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "fuz_pool.h"
+
+// the k best scores seen so far, a score below the k-th one cannot be among the k best anymore, k 0 keeps no bound
+struct fuz_topk_scores {
+    explicit fuz_topk_scores(size_t k) : count(k), heap() {}
+
+    void add(int score)
+    {
+        if (count == 0) return;
+        if (heap.size() < count) {
+            heap.push_back(score);
+            std::push_heap(heap.begin(), heap.end(), std::greater<int>());
+        } else if (score > heap.front()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<int>());
+            heap.back() = score;
+            std::push_heap(heap.begin(), heap.end(), std::greater<int>());
+        }
+    }
+    // lowest score that can still be among the k best, minimum while fewer than k scores are kept
+    int threshold(int minimum) const { return count == 0 || heap.size() < count ? minimum : std::max(minimum, heap.front()); }
+
+private:
+    size_t count;
+    std::vector<int> heap;
+};
+
+// keeps the k best matches of every query of a list sorted by query and reference, the order does not change
+// matches with equal scores are ranked by reference, k 0 keeps all matches
+std::vector<fuz_match> fuz_topk_matches(std::vector<fuz_match> matches, size_t k);
+
+// the k best matches of every imported block over the whole scan, the query blocks are kept by name
+// matches with equal scores are ranked by query name
+class fuz_topk_refs {
+public:
+    fuz_topk_refs(size_t refs, size_t k);
+    fuz_topk_refs(const fuz_topk_refs &) = delete;
+    fuz_topk_refs &operator=(const fuz_topk_refs &) = delete;
+
+    // lowest score a new match of ref needs, read without locking by the comparison threads
+    int threshold(uint32_t ref, int minimum) const { return std::max(minimum, kth[ref].load(std::memory_order_relaxed)); }
+
+    void add(const std::vector<fuz_match> &matches, const std::function<std::string(uint32_t)> &query_name);
+
+    // calls visit(ref, query name, score) for the kept matches, best first for every ref
+    void for_each(const std::function<void(uint32_t, const std::string &, int)> &visit) const;
+
+private:
+    struct entry {
+        int score;
+        std::string query;
+    };
+
+    size_t count;
+    mutable std::mutex mutex;
+    std::vector<std::vector<entry> > heaps;
+    std::unique_ptr<std::atomic<int>[]> kth;
+};
+
+#endif
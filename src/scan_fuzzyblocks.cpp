@@ -6,10 +6,15 @@
  */
 
 // general includes
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <iomanip>
 #include <fstream>
+#include <functional>
+#include <mutex>
 #include <sys/types.h>
+#include <unordered_map>
 #include <vector>
 
 // bulk extractor
@@ -24,14 +29,28 @@ extern "C" {
 #include "mrshv2/header/config.h"
 #include "mrshv2/header/hashing.h"
 #include "mrshv2/header/fingerprintList.h"
+#include "mrshv2/header/popcount.h"
 }
 
 // ssdeep
 #include "fuzzy.h"
 
+// plugin side search structures
+#include "fuz_chunks.h"
+#include "fuz_exact.h"
+#include "fuz_mrshv2.h"
+#include "fuz_pool.h"
+#include "fuz_presence.h"
+#include "fuz_sdhash.h"
+#include "fuz_simhash.h"
+#include "fuz_ssdeep.h"
+#include "fuz_topk.h"
+
+// hash is kept for import files and for digests the plugin cannot parse, parsed is used for all comparisons
 struct ssdeep_digest {
     std::string name;
     char hash[FUZZY_MAX_RESULT] = {};
+    fuz_ssdeep_digest parsed = {};
 };
 
 // user settings
@@ -42,6 +61,28 @@ static uint32_t fuz_step_size = fuz_block_size;         // import or scan
 static int32_t fuz_threshold = 10;                      // scan
 static std::string fuz_hashfile = "fuz_hashes.txt";     // scan
 static std::string fuz_sep = "|";                       // scan
+static uint32_t fuz_threads = 0;                        // scan
+static uint32_t fuz_compare_threads = 0;                // scan
+static uint32_t fuz_compare_queue = 16;                 // scan
+static bool fuz_lsh = false;                            // scan
+static uint32_t fuz_lsh_recall = 95;                    // scan
+static bool fuz_ssdeep_index = true;                    // scan
+static bool fuz_exact = false;                          // import or scan
+static bool fuz_exact_skip = false;                     // scan
+static std::string fuz_mrshv2_engine = "bucket";        // scan
+static bool fuz_mrshv2_fold = false;                    // scan
+static uint32_t fuz_batch = 0;                          // scan
+static bool fuz_predict = false;                        // scan
+static std::string fuz_cascade_hashfile = "";           // scan
+static int32_t fuz_cascade_threshold = 1;               // scan
+static uint32_t fuz_presence_coverage = 50;             // presence
+static uint32_t fuz_presence_hits = 0;                  // presence
+static uint32_t fuz_topk = 0;                           // scan
+static bool fuz_topk_ref = false;                       // scan
+static bool fuz_simhash = false;                        // import or scan
+static uint32_t fuz_simhash_radius = 10;                // scan
+static std::string fuz_sdhash_index = "";               // import or scan
+static std::string fuz_sdhash_scorer = "sdhash";        // scan
 
 // differentiate between sdhash stream and block processing
 static bool fuz_sdhash_dd = true;
@@ -56,18 +97,97 @@ MODES *mode = NULL;
 
 // declarations for imported hash sets in scan mode
 static sdbf_set *imported_sdhash = NULL;
-static FINGERPRINT_LIST *imported_mrshv2 = NULL;
-static std::vector <ssdeep_digest *> imported_ssdeep;
+static fuz_lsh_index *imported_sdhash_lsh = NULL;
+static fuz_candidate_stats sdhash_lsh_stats;
+static index_info *sdhash_info = NULL;
+static std::vector<bloom_filter *> sdhash_index_list;
+static std::vector<sdbf_set *> sdhash_index_sets;
+static fuz_sdhash_index_stats sdhash_index_stats;
+static fuz_sdbf_store *imported_sdhash_store = NULL;
+static fuz_sdbf_scorer_stats sdhash_scorer_stats;
+static fuz_fp_store *imported_mrshv2 = NULL;
+static fuz_fp_slices *imported_mrshv2_slices = NULL;
+static fuz_prune_stats mrshv2_stats;
+static std::vector<uint32_t> *imported_mrshv2_successors = NULL;
+static fuz_predict_stats mrshv2_predict_stats;
+static fuz_presence *mrshv2_presence = NULL;
+static fuz_topk_refs *mrshv2_topk_refs = NULL;
+
+// sdhash-dd digest of every imported mrshv2 fingerprint with the same name, FUZ_NO_CASCADE_REF if there is none
+#define FUZ_NO_CASCADE_REF UINT32_MAX
+static std::vector<uint32_t> cascade_refs;
+
+// counters of the mrshv2 candidates confirmed with sdhash-dd, reported at shutdown
+struct fuz_cascade_stats {
+    std::atomic<uint64_t> candidates{0};
+    std::atomic<uint64_t> hashed{0};
+    std::atomic<uint64_t> confirmed{0};
+};
+static fuz_cascade_stats cascade_stats;
+
+// mrshv2 query blocks of several sbufs, compared in one pass over the imported fingerprints
+struct fuz_fp_batch {
+    fuz_fp_batch() : queries(), digests(), simhashes(), contents() {}
+
+    fuz_fp_store queries;
+    std::vector<fuz_digest128> digests;
+    std::vector<uint64_t> simhashes;
+    // bytes of the blocks for the sdhash-dd confirmation of a cascade
+    std::vector<std::string> contents;
+};
+static fuz_fp_batch *mrshv2_batch = NULL;
+static std::mutex mrshv2_batch_mutex;
+static std::atomic<uint64_t> mrshv2_batches{0};
+static fuz_ssdeep_store *imported_ssdeep = NULL;
+static fuz_ssdeep_gram_index *imported_ssdeep_index = NULL;
+static fuz_candidate_stats ssdeep_stats;
+static fuz_chunk_index *imported_chunks = NULL;
+static fuz_candidate_stats chunk_stats;
+static fuz_exact_index *imported_exact = NULL;
+static fuz_exact_stats exact_stats;
+static fuz_simhash_index *imported_simhash = NULL;
+static fuz_candidate_stats simhash_stats;
+
+// comparison threads that split a single sbuf across partitions of the imported hashes
+static fuz_pool *compare_pool = NULL;
+
+// comparison threads that take whole sbufs from the bulk_extractor threads, NULL if these compare themselves
+static fuz_job_queue *compare_queue = NULL;
+
+// sdhash inserts into the feature index without locking, import threads hash one block at a time
+static std::mutex sdhash_index_mutex;
+
+// imported sdhash and ssdeep hashes per partition
+#define FUZ_SDHASH_PARTITION_SIZE 64
+#define FUZ_SSDEEP_PARTITION_SIZE 1024
 
 static void do_sdhash_import(const class scanner_params &sp, const recursion_control_block &rcb);
 static void do_sdhash_scan(const class scanner_params &sp, const recursion_control_block &rcb);
 
 static void do_mrshv2_import(const class scanner_params &sp, const recursion_control_block &rcb);
 static void do_mrshv2_scan(const class scanner_params &sp, const recursion_control_block &rcb);
+static void fuz_compare_fp_batch(feature_recorder *fuz_scores_recorder, const fuz_fp_batch &batch);
 
 static void do_ssdeep_import(const class scanner_params &sp, const recursion_control_block &rcb);
 static void do_ssdeep_scan(const class scanner_params &sp, const recursion_control_block &rcb);
 
+static void do_chunks_import(const class scanner_params &sp, const recursion_control_block &rcb);
+static void do_chunks_scan(const class scanner_params &sp, const recursion_control_block &rcb);
+
+// runs the comparison job of an sbuf in the sbuf comparison threads, or right away without them
+// the job owns the hashed blocks and frees them
+inline void fuz_submit(const std::function<void()> &job)
+{
+    if (compare_queue != NULL) compare_queue->push(job);
+    else job();
+}
+
+// true for imported mrshv2 blocks of files that are already present, they are not compared anymore
+inline bool fuz_retired(uint32_t ref)
+{
+    return mrshv2_presence != NULL && mrshv2_presence->retired(ref);
+}
+
 // detect if block is empty
 inline bool empty_sbuf(const sbuf_t &sbuf)
 {
@@ -79,9 +199,91 @@ inline bool empty_sbuf(const sbuf_t &sbuf)
     return true;    // all the same
 }
 
-// loads all sdbfs from a file into a new set
+// returns the side signature lines of a block for the import file
+inline std::string fuz_side_lines(const sbuf_t &sbuf, const std::string &name)
+{
+    std::string lines;
+    if (fuz_exact) lines += FUZ_EXACT_PREFIX + fuz_exact_to_string(fuz_exact_digest(sbuf.buf, sbuf.bufsize)) + ":" + name + "\n";
+    if (fuz_simhash) lines += FUZ_SIMHASH_PREFIX + fuz_simhash_to_string(fuz_simhash_signature(sbuf.buf, sbuf.bufsize)) + ":" + name + "\n";
+    return lines;
+}
+
+// reads the side signature lines of a hash file, parse(line, name) returns false for other lines,
+// add(ref) stores the parsed signature for the imported similarity hash with the same block name
+template <class Parse, class Add>
+inline void fuz_side_list(const char *fname, const std::vector<std::string> &names, const char *what, Parse parse, Add add)
+{
+    std::unordered_map<std::string, uint32_t> refs;
+    for (size_t i = 0; i < names.size(); i++) refs[names[i]] = i;
+
+    std::string line;
+    ifstream ifs(fname, ifstream::in|ios::binary);
+    if (ifs.is_open()) {
+        while(std::getline(ifs, line)) {
+            if (line.length()==0) break;
+
+            std::string name;
+            if (!parse(line, name)) continue;
+
+            auto ref = refs.find(name);
+            if (ref == refs.end()) {
+                std::cerr << what << " without similarity hash: " << name << "\n";
+                continue;
+            }
+            add(ref->second);
+        }
+    } else {
+        std::cerr << "Cannot open: " << fname << "\n";
+    }
+}
+
+// loads the exact digests of a hash file into an index
+inline void fuz_exact_list(const char *fname, const std::vector<std::string> &names, fuz_exact_index &index)
+{
+    fuz_digest128 digest;
+    fuz_side_list(fname, names, "Exact digest",
+                  [&](const std::string &line, std::string &name) { return fuz_exact_parse(line, digest, name); },
+                  [&](uint32_t ref) { index.add(digest, ref); });
+    index.finalize();
+}
+
+// loads the simhashes of a hash file into a multi-index table
+inline void fuz_simhash_list(const char *fname, const std::vector<std::string> &names, fuz_simhash_index &index)
+{
+    uint64_t signature;
+    fuz_side_list(fname, names, "Simhash",
+                  [&](const std::string &line, std::string &name) { return fuz_simhash_parse(line, signature, name); },
+                  [&](uint32_t ref) { index.add(signature, ref); });
+    index.finalize();
+}
+
+// simhash candidates of a query block
+inline void fuz_simhash_candidates(const fuz_simhash_index &index, uint64_t signature, std::vector<uint32_t> &refs)
+{
+    index.candidates(signature, refs);
+    simhash_stats.candidates += refs.size();
+}
+
+// true if the features of a query sdbf hashed with sdhash_info did not hit the imported feature index,
+// a heuristic: sdbf scores come from the bit overlap of the filters, not from exact feature hits, so a rejected
+// block is unlikely but not guaranteed to score low, exact matches are always kept
+// digest is the exact digest of the block, only read with an exact index
+inline bool fuz_sdhash_rejected(sdbf *query, const fuz_digest128 &digest)
+{
+    sdhash_index_stats.blocks++;
+    if (!query->get_index_results().empty()) return false;
+    if (imported_exact != NULL) {
+        std::vector<uint32_t> refs;
+        imported_exact->lookup(digest, refs);
+        if (!refs.empty()) return false;
+    }
+    sdhash_index_stats.rejected++;
+    return true;
+}
+
+// loads all sdbfs from a file into a new set and/or a flat store, either can be NULL
 // similar to the sdbf api function sdbf_set::sdbf_set(const char *fname) but skips lines beginning with #
-inline void fuz_sdbf_set(const char *fname, sdbf_set *newset)
+inline void fuz_sdbf_set(const char *fname, sdbf_set *newset, fuz_sdbf_store *store)
 {   
     std::string line;
     ifstream ifs(fname, ifstream::in|ios::binary);
@@ -92,6 +294,13 @@ inline void fuz_sdbf_set(const char *fname, sdbf_set *newset)
                 
                 // skip comments
                 if (line[0] == '#') continue;
+                
+                if (store != NULL && !store->add(line)) {
+                    std::cerr << "Error.  Cannot parse sdhash-dd hash in '" << fname << "': " << line.substr(0, 64) << "\n"
+                              << "Cannot continue.\n";
+                    exit(1);
+                }
+                if (newset == NULL) continue;
                
                 newset->set_name((string)fname);
                 sdbf *sdbfm = new sdbf(line);
@@ -102,17 +311,25 @@ inline void fuz_sdbf_set(const char *fname, sdbf_set *newset)
         }
         
         ifs.close();
-        newset->vector_init();
+        if (newset != NULL) newset->vector_init();
 }
 
 // compares two sdbf sets and returns results
 // similar to sdbf_set::compare_to_quiet(sdbf_set *other, int32_t threshold, uint32_t sample_size, int32_t thread_count, bool fast)
-// but without utilizing openmp multi-threading code (bulk_extractor should handle multi-threading)
-inline std::string fuz_compare_two_sets(sdbf_set *set1, sdbf_set *set2, int32_t threshold, uint32_t sample_size, bool fast)
+// but without utilizing openmp multi-threading code, set2 is split into partitions for the plugin comparison threads
+// with an lsh index or a simhash index of set2 only the candidates of each sdbf in set1 are compared
+// exact matches of set1 in set2 are reported with score 100, skipped sdbfs of set1 are not compared at all
+// with flat copies of both sets the plugin scorer replaces sdbf::compare or, in verify mode, is checked against it,
+// set2 is NULL if the imported blocks are only kept in store2
+// with fuz_topk a pair has to reach the k-th best score of its query so far, the plugin scorer stops early below it
+inline std::string fuz_compare_two_sets(sdbf_set *set1, sdbf_set *set2, const fuz_lsh_index *lsh, const fuz_simhash_index *simhash,
+                                       const std::vector<uint64_t> &simhashes, const fuz_exact_hits &exact,
+                                       const fuz_sdbf_store *store1, const fuz_sdbf_store *store2,
+                                       int32_t threshold, uint32_t sample_size, bool fast)
 {
     std::stringstream out;
     out.fill('0');
-    int tend = set2->size();
+    int tend = (set2 != NULL) ? set2->size() : store2->size();
     int qend = set1->size();
 
     // fast mode unused for now
@@ -125,32 +342,109 @@ inline std::string fuz_compare_two_sets(sdbf_set *set1, sdbf_set *set2, int32_t
         }
     }
     
-    for (int i = 0; i < qend ; i++) {
-        for (int j = 0; j < tend ; j++) {
-            int32_t score = set1->at(i)->compare(set2->at(j), sample_size);
-            if (score >= threshold) {
-                {
-                out << set1->at(i)->name() << fuz_sep << set2->at(j)->name() ;
-                if (score != -1)
-                    out << fuz_sep << setw (3) << score << std::endl;
-                else 
-                    out << fuz_sep << score << std::endl;
+    const bool verify = (fuz_sdhash_scorer == "verify");
+    auto compare = [&](uint32_t i, uint32_t j, int32_t pair_threshold) -> int32_t {
+        if (store1 == NULL) return set1->at(i)->compare(set2->at(j), sample_size);
+        if (!verify) return fuz_sdbf_score(*store1, i, *store2, j, pair_threshold);
+        int32_t score = set1->at(i)->compare(set2->at(j), sample_size);
+        sdhash_scorer_stats.pairs++;
+        if (fuz_sdbf_score(*store1, i, *store2, j, 0) != score) sdhash_scorer_stats.mismatches++;
+        return score;
+    };
+
+    std::vector<std::vector<fuz_match> > buffers(compare_pool->workers());
+    if (lsh != NULL || simhash != NULL) {
+        compare_pool->parallel_for(qend, [&](size_t i, unsigned worker) {
+            if (exact.skipped(i)) return;
+            sdbf *query = set1->at(i);
+            std::vector<uint32_t> candidates;
+            if (simhash != NULL) {
+                fuz_simhash_candidates(*simhash, simhashes[i], candidates);
+            } else {
+                for (uint32_t f = 0; f < query->filter_count(); f++) {
+                    uint8_t *filter = query->clone_filter(f);
+                    lsh->candidates(filter, candidates);
+                    free(filter);
                 }
+                std::sort(candidates.begin(), candidates.end());
+                candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+                sdhash_lsh_stats.candidates += candidates.size();
             }
-        }
+
+            fuz_topk_scores best(fuz_topk);
+            for (uint32_t j : candidates) {
+                const int32_t pair_threshold = best.threshold(threshold);
+                int32_t score = compare(i, j, pair_threshold);
+                if (score < pair_threshold) continue;
+                buffers[worker].push_back({(uint32_t)i, j, score});
+                best.add(score);
+            }
+        });
+        if (simhash != NULL) simhash_stats.pairs += (uint64_t)qend * tend;
+        else sdhash_lsh_stats.pairs += (uint64_t)qend * tend;
+    } else {
+        size_t partitions = (tend + FUZ_SDHASH_PARTITION_SIZE - 1) / FUZ_SDHASH_PARTITION_SIZE;
+        compare_pool->parallel_for(partitions, [&](size_t p, unsigned worker) {
+            int jend = MIN(tend, (int)((p + 1) * FUZ_SDHASH_PARTITION_SIZE));
+            for (int i = 0; i < qend ; i++) {
+                if (exact.skipped(i)) continue;
+                fuz_topk_scores best(fuz_topk);
+                for (int j = p * FUZ_SDHASH_PARTITION_SIZE; j < jend ; j++) {
+                    const int32_t pair_threshold = best.threshold(threshold);
+                    int32_t score = compare(i, j, pair_threshold);
+                    if (score < pair_threshold) continue;
+                    buffers[worker].push_back({(uint32_t)i, (uint32_t)j, score});
+                    best.add(score);
+                }
+            }
+        });
+    }
+
+    for (auto &match : fuz_topk_matches(fuz_merge_exact(fuz_merge_matches(buffers), exact), fuz_topk)) {
+        out << set1->at(match.query)->name() << fuz_sep << ((set2 != NULL) ? set2->at(match.ref)->name() : store2->name(match.ref));
+        if (match.score != -1)
+            out << fuz_sep << setw (3) << match.score << std::endl;
+        else 
+            out << fuz_sep << match.score << std::endl;
     }
     
     return out.str();
 }
 
-// loads all mrshv2 fingerprints from a file into a new fingerprint list
+// builds the lsh index over all filters of the imported blocks, for_each_filter(visit) calls visit(ref, filter)
+// for every filter of an sdbf set or a flat store
+// the target similarity is the one of a small filter (10th percentile of bits set) and a large filter (90th percentile),
+// pairs of different sizes reach threshold with less similarity
+template <typename ForEachFilter>
+inline void fuz_lsh_build(ForEachFilter for_each_filter, fuz_lsh_index &lsh, int32_t threshold, uint32_t recall)
+{
+    std::vector<int> bits;
+    for_each_filter([&](uint32_t, const uint8_t *filter) {
+        int count = 0;
+        for (int i = 0; i < FUZ_SDBF_FILTER_SIZE; i++) count += __builtin_popcount(filter[i]);
+        if (count > 0) bits.push_back(count);
+    });
+    if (bits.empty()) return;
+
+    std::sort(bits.begin(), bits.end());
+    double jaccard = fuz_lsh_jaccard(threshold, bits[bits.size() / 10], bits[bits.size() * 9 / 10]);
+    lsh.configure(jaccard, recall / 100.0);
+
+    for_each_filter([&](uint32_t ref, const uint8_t *filter) { lsh.add(ref, filter); });
+    lsh.finalize();
+
+    std::cout << "LSH bands: " << lsh.bands << ", rows: " << lsh.rows
+              << ", target similarity: " << jaccard << ", expected recall: " << lsh.recall(jaccard) << std::endl;
+}
+
+// loads all mrshv2 fingerprints from a file into a flat fingerprint store
 // similar to mrshv2s read_fingerprint_file(FINGERPRINT_LIST *fpl, FILE *handle) but with b64 decoding and skipping of comment lines beginning with #
-inline void fuz_fp_list(const char *fname, FINGERPRINT_LIST *fpl)
+inline void fuz_fp_list(const char *fname, fuz_fp_store &store)
 {
     char delim = ':';
-    int amount_of_BF = 0, blocks_in_last_bf = 0;
     std::string line;
-    char *b64_string;
+    // length of an encoded bloomfilter
+    const uint32_t bf_b64_length = 4 * (FILTERSIZE/3 + 1 * (FILTERSIZE % 3 > 0 ? 1 : 0));
     
     ifstream ifs(fname, ifstream::in|ios::binary);
     if (ifs.is_open()) {
@@ -161,79 +455,35 @@ inline void fuz_fp_list(const char *fname, FINGERPRINT_LIST *fpl)
             // skip comments
             if (line[0] == '#') continue;               
             
-            FINGERPRINT *fp = init_empty_fingerprint();
-            add_new_fingerprint(fpl, fp);
-            
+            // filename:filesize:count of the filters:filter block count:b64 fingerprint
+            std::vector<std::string> items;
             stringstream linestream(line);
             std::string item;
-            int counter = 0;
-            
-            while (std::getline(linestream, item, delim)) {
-                switch(counter) {
-                    case 0:
-                        // get the filename
-                        strcpy(fp->file_name, item.c_str());
-                        break;
-                        
-                    case 1:
-                        // get the filesize
-                        fp->filesize = stoi(item);
-                        break;
-                        
-                    case 2:
-                        // get the count of the filters
-                        amount_of_BF = stoi(item);
-                        break;
-                        
-                    case 3:
-                        // get the filter block count
-                        blocks_in_last_bf = stoi(item);
-                        break;
-                        
-                    case 4:
-                        // get the b64 fingerprint
-                        b64_string = (char*)calloc(item.length()+1, sizeof(char));
-                        strcpy(b64_string, item.c_str());
-                        break;
+            while (std::getline(linestream, item, delim)) items.push_back(item);
 
-                    default:
-                        std::cerr << "Error parsing fingerprint file\n";
-                        break;
-                }
-                    
-                counter++;
+            if (items.size() != 5) {
+                std::cerr << "Error parsing fingerprint file\n";
+                continue;
+            }
 
-                if(b64_string!=NULL) {
-                    // reset bf_list when we read in a LIST
-                    fp->bf_list = NULL;
-                    fp->bf_list_last_element = NULL;
-                    // length of an encoded bloomfilter
-                    uint32_t bf_b64_length = 4 * (FILTERSIZE/3 + 1 * (FILTERSIZE % 3 > 0 ? 1 : 0));
-                    
-                    for(int i=0; i<=amount_of_BF; i++) {
-                        // create new bloomfilter and add it to the fingerprint
-                        BLOOMFILTER *bf = init_empty_BF();
-                        add_new_bloomfilter(fp, bf);
-                        
-                        //decode b64 filter to binary
-                        int dec_len = 0;
-                        unsigned char *dec_str = (uint8_t *)b64decode((char*)b64_string + i*bf_b64_length, (int)bf_b64_length, &dec_len);
-                                      
-                        // fill bf
-                        memcpy(bf->array, dec_str, FILTERSIZE);
-                        
-                        bf->amount_of_blocks = MAXBLOCKS;
-                        free(dec_str);
-                        dec_str = NULL;
-                    }
-                    
-                    // the last bloomfilter may not have MAXBLOCKS -> update it
-                    fp->bf_list_last_element->amount_of_blocks = blocks_in_last_bf;
-                    
-                    free(b64_string);
-                    b64_string = NULL;
-                }
-              }
+            int amount_of_BF = stoi(items[2]);
+            int blocks_in_last_bf = stoi(items[3]);
+            std::string &b64_string = items[4];
+            if (amount_of_BF < 0 || b64_string.length() < (amount_of_BF+1) * bf_b64_length) {
+                std::cerr << "Error parsing fingerprint file\n";
+                continue;
+            }
+
+            store.add_fingerprint(items[0]);
+            for(int i=0; i<=amount_of_BF; i++) {
+                //decode b64 filter to binary
+                int dec_len = 0;
+                unsigned char *dec_str = (uint8_t *)b64decode(&b64_string[0] + i*bf_b64_length, (int)bf_b64_length, &dec_len);
+
+                // the last bloomfilter may not have MAXBLOCKS
+                store.add_filter(dec_str, i < amount_of_BF ? MAXBLOCKS : blocks_in_last_bf);
+                free(dec_str);
+            }
         }
     } else {
         std::cerr << "Cannot open: " << fname << "\n";
@@ -277,33 +527,377 @@ inline std::string fuz_fplist_to_string(const FINGERPRINT_LIST *fpl)
     return fpl_str.str();
 }
 
-// Compares two mrshv2 fingerprint lists and returns results
-inline std::string fuz_compare_two_fplists(const FINGERPRINT_LIST *fpl1, const FINGERPRINT_LIST *fpl2)
+// Compares the query store with one partition of the imported mrshv2 fingerprints
+// buckets and pairs that cannot reach the threshold are skipped without changing any reported score,
+// pairs are checked on the segment popcounts and, if the references are folded, on the folds before the full filters are read
+// single filter queries are scored in groups of AND_POPCOUNT_GROUP against one reference bucket at a time,
+// so each bucket is read from memory once per call and stays in cache for all queries
+// without bucket_search only the pairs with a multi filter fingerprint are compared
+// with fuz_topk the single filter pairs also have to reach the k-th best score of the query in this partition,
+// or of the reference over the whole scan with topk_refs, which raises the threshold of the later pairs
+static void fuz_compare_fp_partition(const fuz_fp_store &refs, const fuz_fp_partition &partition, const fuz_fp_store &queries,
+                                     const std::vector<uint32_t> &single, const std::vector<uint32_t> &multi, bool bucket_search,
+                                     std::vector<fuz_match> &matches)
 {
-    std::stringstream out;
     int score;
-    FINGERPRINT *tmp1 = fpl1->list;
-    out.fill('0');
+    const int threshold = mode->threshold;
+    uint64_t pruned_bucket = 0, pruned_bound = 0, pruned_fold = 0, retired = 0;
 
-    while (tmp1 != NULL){
-        FINGERPRINT *tmp2 = fpl2->list;
-        
-        while (tmp2 != NULL){
-            score = fingerprint_compare(tmp1, tmp2);
-            
-            if(score >= mode->threshold)
-                out << tmp1->file_name << fuz_sep << tmp2->file_name << fuz_sep << setw(3) << score << std::endl;
-            
-            tmp2 = tmp2->next;
+    // multi filter fingerprints on either side are compared without pruning
+    for (uint32_t q : multi) {
+        for (size_t r = partition.ref_begin; r < partition.ref_end; r++) {
+            if (fuz_retired(r)) {
+                retired++;
+                continue;
+            }
+            score = fuz_fp_compare(refs, r, queries, q);
+            if(score >= threshold) matches.push_back({q, (uint32_t)r, score});
         }
-        tmp1 = tmp1->next;
     }
-        
-    return out.str();
-}   
+    for (uint32_t q : single) {
+        for (size_t r = MAX(partition.ref_begin, refs.single_filter_end); r < partition.ref_end; r++) {
+            if (fuz_retired(r)) {
+                retired++;
+                continue;
+            }
+            score = fuz_fp_compare(refs, r, queries, q);
+            if(score >= threshold) matches.push_back({q, (uint32_t)r, score});
+        }
+    }
+    if (!bucket_search) {
+        if (mrshv2_presence != NULL) mrshv2_presence->skipped += retired;
+        return;
+    }
+
+    // a cascade reports other scores than mrshv2, they cannot raise the threshold
+    const bool topk = fuz_topk != 0 && imported_sdhash == NULL;
+    const fuz_topk_refs *topk_refs = topk ? mrshv2_topk_refs : NULL;
+    std::vector<fuz_topk_scores> best(topk && topk_refs == NULL ? single.size() : 0, fuz_topk_scores(fuz_topk));
+    auto query_threshold = [&](size_t i) { return best.empty() ? threshold : best[i].threshold(threshold); };
+
+    for (size_t b = partition.bucket_begin; b < partition.bucket_end; b++) {
+        const fuz_fp_bucket &bucket = refs.buckets[b];
+        for (size_t g = 0; g < single.size(); g += AND_POPCOUNT_GROUP) {
+            const size_t group_size = MIN(single.size() - g, (size_t)AND_POPCOUNT_GROUP);
+            const unsigned char *group[AND_POPCOUNT_GROUP];
+            bool active[AND_POPCOUNT_GROUP];
+            bool any_active = false;
+            // all references of a bucket have the same blocks, so e_min only depends on the query
+            int e_min[AND_POPCOUNT_GROUP];
+            bool scores_zero[AND_POPCOUNT_GROUP];
+
+            for (size_t k = 0; k < AND_POPCOUNT_GROUP; k++) {
+                // unused slots repeat the first query, their counts are ignored
+                const uint32_t qf = queries.first_filter[single[g + (k < group_size ? k : 0)]];
+                const short query_blocks = queries.blocks[qf];
+                group[k] = queries.filter(qf);
+                active[k] = k < group_size;
+                e_min[k] = lookup_e_min(bucket.blocks, query_blocks);
+                scores_zero[k] = bucket.blocks < MINBLOCKS || query_blocks < MINBLOCKS;
+                if (!active[k]) continue;
+                const int bucket_threshold = query_threshold(g + k);
+                if (bucket_threshold <= 0) continue;
+
+                // the bucket needs at least the bits of its smallest e_max, but can have at most the bound of its largest segments
+                bool skip = bucket_threshold > 100 || scores_zero[k];
+                if (!skip && bucket.blocks <= MAXBLOCKS && query_blocks <= MAXBLOCKS) {
+                    int needed = fuz_bits_needed(bucket.blocks, query_blocks, MIN(queries.bits_set[qf], bucket.min_bits_set),
+                                                 bucket_threshold);
+                    skip = needed >= 0 && fuz_common_bound(queries.segment_counts(qf), bucket.max_segments) < needed;
+                }
+                if (skip) {
+                    pruned_bucket += bucket.end - bucket.begin;
+                    active[k] = false;
+                }
+            }
+            for (size_t k = 0; k < group_size; k++) any_active |= active[k];
+            if (!any_active) continue;
+
+            for (size_t r = bucket.begin; r < bucket.end; r++) {
+                if (fuz_retired(r)) {
+                    for (size_t k = 0; k < group_size; k++) retired += active[k];
+                    continue;
+                }
+                const uint32_t rf = refs.first_filter[r];
+                const int ref_threshold = topk_refs != NULL ? topk_refs->threshold(r, threshold) : threshold;
+                unsigned short common[AND_POPCOUNT_GROUP];
+                int cut_off[AND_POPCOUNT_GROUP], e_max[AND_POPCOUNT_GROUP], needed[AND_POPCOUNT_GROUP], pair_threshold[AND_POPCOUNT_GROUP];
+                bool score_query[AND_POPCOUNT_GROUP];
+                int scored = 0;
+
+                for (size_t k = 0; k < group_size; k++) {
+                    score_query[k] = active[k];
+                    if (!active[k]) continue;
+
+                    const uint32_t qf = queries.first_filter[single[g + k]];
+                    e_max[k] = MIN(queries.bits_set[qf], refs.bits_set[rf]);
+                    cut_off[k] = compute_cut_off(e_min[k], e_max[k]);
+                    pair_threshold[k] = MAX(query_threshold(g + k), ref_threshold);
+                    needed[k] = fuz_bits_needed_cut_off(cut_off[k], e_max[k], pair_threshold[k]);
+                    if (pair_threshold[k] <= 0) continue;
+
+                    if (needed[k] < 0 || fuz_common_bound(queries.segment_counts(qf), refs.segment_counts(rf)) < needed[k]) {
+                        pruned_bound++;
+                        score_query[k] = false;
+                    }
+                }
+                for (size_t k = 0; k < group_size; k++) scored += score_query[k];
+                if (scored == 0) continue;
+
+                if (threshold > 0 && refs.folds) {
+                    int fold_bound[AND_POPCOUNT_GROUP];
+                    fuz_fold_bounds(refs.fold(rf), group, group_size, fold_bound);
+                    for (size_t k = 0; k < group_size; k++) {
+                        if (score_query[k] && fold_bound[k] < needed[k]) {
+                            pruned_fold++;
+                            score_query[k] = false;
+                            scored--;
+                        }
+                    }
+                    if (scored == 0) continue;
+                }
+
+                // a lone query is cheaper with the single kernel
+                if (scored == 1) {
+                    for (size_t k = 0; k < group_size; k++) {
+                        if (score_query[k]) common[k] = and_popcount(refs.filter(rf), group[k]);
+                    }
+                } else {
+                    and_popcount_group(refs.filter(rf), group, common);
+                }
+
+                for (size_t k = 0; k < group_size; k++) {
+                    if (!score_query[k]) continue;
+                    score = scores_zero[k] ? 0 : fuz_filter_score_cut_off(cut_off[k], e_max[k], common[k]);
+                    if (score < pair_threshold[k]) continue;
+                    matches.push_back({single[g + k], (uint32_t)r, score});
+                    if (!best.empty()) best[g + k].add(score);
+                }
+            }
+        }
+    }
+
+    mrshv2_stats.pruned_bucket += pruned_bucket;
+    mrshv2_stats.pruned_bound += pruned_bound;
+    mrshv2_stats.pruned_fold += pruned_fold;
+    if (mrshv2_presence != NULL) mrshv2_presence->skipped += retired;
+}
+
+// Compares the single filter queries with one partition of the bit-sliced imported mrshv2 fingerprints
+// only the candidates with enough bits in common to reach the threshold are scored
+static void fuz_compare_fp_slices(const fuz_fp_store &refs, const fuz_fp_slices &slices, size_t partition, const fuz_fp_store &queries,
+                                  const std::vector<uint32_t> &single, std::vector<fuz_match> &matches)
+{
+    int score;
+    const int threshold = mode->threshold;
+    uint64_t pruned_slices = 0, retired = 0;
+    std::vector<uint32_t> candidates;
+
+    for (uint32_t q : single) {
+        const uint32_t qf = queries.first_filter[q];
+        candidates.clear();
+        pruned_slices += slices.candidates(queries.filter(qf), queries.segment_counts(qf), queries.blocks[qf], queries.bits_set[qf],
+                                            threshold, partition, candidates);
+        pruned_slices -= candidates.size();
+
+        for (uint32_t r : candidates) {
+            if (fuz_retired(r)) {
+                retired++;
+                continue;
+            }
+            score = fuz_fp_compare(refs, r, queries, q);
+            if(score >= threshold) matches.push_back({q, r, score});
+        }
+    }
+
+    mrshv2_stats.pruned_slices += pruned_slices;
+    if (mrshv2_presence != NULL) mrshv2_presence->skipped += retired;
+}
+
+// Compares the single and multi filter queries with all imported mrshv2 fingerprints and appends the matches to the buffers
+// the partitions of the imported store are spread over the plugin comparison threads
+// with slices the single filter pairs are compared in the partitions of the slices instead of the buckets,
+// with a simhash index each query is only compared with its candidates
+static void fuz_sweep_fplists(const fuz_fp_store &refs, const fuz_fp_slices *slices, const fuz_simhash_index *simhash,
+                              const fuz_fp_store &queries, const std::vector<uint64_t> &simhashes, std::vector<uint32_t> single,
+                              const std::vector<uint32_t> &multi, std::vector<std::vector<fuz_match> > &buffers)
+{
+    const int threshold = mode->threshold;
+    if (simhash != NULL) {
+        single.insert(single.end(), multi.begin(), multi.end());
+        compare_pool->parallel_for(single.size(), [&](size_t k, unsigned worker) {
+            const uint32_t q = single[k];
+            std::vector<uint32_t> candidates;
+            fuz_simhash_candidates(*simhash, simhashes[q], candidates);
+            for (uint32_t r : candidates) {
+                if (fuz_retired(r)) continue;
+                int score = fuz_fp_compare(refs, r, queries, q);
+                if (score >= threshold) buffers[worker].push_back({q, r, score});
+            }
+        });
+    } else {
+        const size_t slice_partitions = slices != NULL ? slices->partitions() : 0;
+        compare_pool->parallel_for(refs.partitions.size() + slice_partitions, [&](size_t p, unsigned worker) {
+            if (p < refs.partitions.size()) {
+                fuz_compare_fp_partition(refs, refs.partitions[p], queries, single, multi, slices == NULL, buffers[worker]);
+            } else {
+                fuz_compare_fp_slices(refs, *slices, p - refs.partitions.size(), queries, single, buffers[worker]);
+            }
+        });
+    }
+}
+
+// Compares the seed queries with all imported mrshv2 fingerprints and predicts that the block behind a match matches
+// the successor of its best imported block, a query whose prediction reaches the threshold is reported with that
+// block only, the other queries are compared with all imported fingerprints as well
+static void fuz_predict_fplists(const fuz_fp_store &refs, const std::vector<uint32_t> &successors, const fuz_fp_slices *slices,
+                                const fuz_simhash_index *simhash, const fuz_fp_store &queries, const std::vector<uint64_t> &simhashes,
+                                const std::vector<uint32_t> &single, const std::vector<uint32_t> &multi,
+                                std::vector<std::vector<fuz_match> > &buffers)
+{
+    const int threshold = mode->threshold;
+    std::vector<bool> compared(queries.size(), false);
+    for (uint32_t q : single) compared[q] = true;
+    for (uint32_t q : multi) compared[q] = true;
+
+    // a query follows the one before if it is the next block of the same sbuf, runs start with a seed
+    // and get another one every FUZ_PREDICT_SEED_INTERVAL blocks
+    std::vector<bool> follows(queries.size(), false), seed(queries.size(), false);
+    size_t previous_length = 0, run = 0;
+    uint64_t previous_offset = 0;
+    bool previous_named = false;
+    for (size_t q = 0; q < queries.size(); q++) {
+        size_t length = 0;
+        uint64_t offset = 0;
+        const bool named = fuz_block_offset(queries.name(q), length, offset);
+        follows[q] = named && previous_named && length == previous_length && offset == previous_offset + fuz_step_size &&
+                     strncmp(queries.name(q), queries.name(q - 1), length) == 0;
+        run = follows[q] ? run + 1 : 0;
+        seed[q] = run % FUZ_PREDICT_SEED_INTERVAL == 0;
+        previous_named = named;
+        previous_length = length;
+        previous_offset = offset;
+    }
+
+    std::vector<uint32_t> seed_single, seed_multi;
+    for (uint32_t q : single) if (seed[q]) seed_single.push_back(q);
+    for (uint32_t q : multi) if (seed[q]) seed_multi.push_back(q);
+    fuz_sweep_fplists(refs, slices, simhash, queries, simhashes, seed_single, seed_multi, buffers);
+    std::vector<fuz_match> seed_matches = fuz_merge_matches(buffers);
+
+    // best imported block of every matched query, the first one on equal scores
+    std::vector<uint32_t> best(queries.size(), FUZ_NO_SUCCESSOR);
+    std::vector<int> best_score(queries.size(), -1);
+    for (auto &match : seed_matches) {
+        if (match.score > best_score[match.query]) {
+            best[match.query] = match.ref;
+            best_score[match.query] = match.score;
+        }
+    }
+
+    // predictions run in block order, so a confirmed successor predicts the next one
+    std::vector<fuz_match> predicted_matches;
+    std::vector<bool> confirmed(queries.size(), false);
+    uint64_t predicted = 0;
+    for (size_t q = 1; q < queries.size(); q++) {
+        if (seed[q] || !compared[q] || !follows[q] || best[q - 1] == FUZ_NO_SUCCESSOR) continue;
+        const uint32_t r = successors[best[q - 1]];
+        if (r == FUZ_NO_SUCCESSOR || fuz_retired(r)) continue;
+
+        predicted++;
+        const int score = fuz_fp_compare(refs, r, queries, q);
+        if (score < threshold) continue;
+        confirmed[q] = true;
+        best[q] = r;
+        predicted_matches.push_back({(uint32_t)q, r, score});
+    }
+
+    std::vector<uint32_t> rest_single, rest_multi;
+    for (uint32_t q : single) if (!seed[q] && !confirmed[q]) rest_single.push_back(q);
+    for (uint32_t q : multi) if (!seed[q] && !confirmed[q]) rest_multi.push_back(q);
+    fuz_sweep_fplists(refs, slices, simhash, queries, simhashes, rest_single, rest_multi, buffers);
+
+    buffers.push_back(seed_matches);
+    buffers.push_back(predicted_matches);
+
+    mrshv2_predict_stats.seeds += seed_single.size() + seed_multi.size();
+    mrshv2_predict_stats.predicted += predicted;
+    mrshv2_predict_stats.confirmed += predicted_matches.size();
+}
+
+// Compares the imported mrshv2 fingerprints with the fingerprints of a query store and returns the matches
+// sorted by query and reference, without the exact matches
+// with successors the matches of seed queries predict the matches of the queries behind them
+// skipped queries are not compared at all
+inline std::vector<fuz_match> fuz_match_two_fplists(const fuz_fp_store &refs, const fuz_fp_slices *slices, const fuz_simhash_index *simhash,
+                                                    const std::vector<uint32_t> *successors, const fuz_fp_store &queries,
+                                                    const std::vector<uint64_t> &simhashes, const fuz_exact_hits &exact)
+{
+    const int threshold = mode->threshold;
+    uint64_t pruned_query = 0;
+    std::vector<uint32_t> single, multi;
+
+    for (size_t q = 0; q < queries.size(); q++) {
+        if (exact.skipped(q)) continue;
+        // a single filter query with less than MINBLOCKS blocks scores 0 against anything
+        if (threshold > 0 && queries.filter_count[q] == 1 && queries.blocks[queries.first_filter[q]] < MINBLOCKS) {
+            pruned_query += refs.size();
+            continue;
+        }
+        if (queries.filter_count[q] == 1) single.push_back(q);
+        else multi.push_back(q);
+    }
+
+    std::vector<std::vector<fuz_match> > buffers(compare_pool->workers());
+    if (successors != NULL) {
+        fuz_predict_fplists(refs, *successors, slices, simhash, queries, simhashes, single, multi, buffers);
+    } else {
+        fuz_sweep_fplists(refs, slices, simhash, queries, simhashes, single, multi, buffers);
+    }
+    if (simhash != NULL) simhash_stats.pairs += queries.size() * refs.size();
+
+    mrshv2_stats.pairs += queries.size() * refs.size();
+    mrshv2_stats.pruned_query += pruned_query;
 
-// loads all ssdeep hashes from a file into a new ssdeep set
-inline void fuz_ssdeep_list(const char *fname, std::vector <ssdeep_digest *> &ssdeep_list)
+    return fuz_merge_matches(buffers);
+}
+
+// Scores the mrshv2 candidates of the query blocks with the sdhash-dd digests of the same imported blocks and returns
+// the matches sorted by query and reference, a query block is only hashed with sdhash-dd if it has candidates
+inline std::vector<fuz_match> fuz_cascade_sdhash(sdbf_set *sdhash_refs, const std::vector<uint32_t> &sdhash_ref, const fuz_fp_store &queries,
+                                                 const std::vector<std::string> &contents, const std::vector<fuz_match> &candidates,
+                                                 int32_t threshold)
+{
+    // candidates of one query are next to each other
+    std::vector<size_t> query_begin;
+    for (size_t c = 0; c < candidates.size(); c++) {
+        if (c == 0 || candidates[c].query != candidates[c - 1].query) query_begin.push_back(c);
+    }
+    query_begin.push_back(candidates.size());
+
+    std::vector<std::vector<fuz_match> > buffers(compare_pool->workers());
+    compare_pool->parallel_for(query_begin.size() - 1, [&](size_t k, unsigned worker) {
+        const uint32_t q = candidates[query_begin[k]].query;
+        sdbf *query = new sdbf(queries.name(q), (char *)contents[q].data(), fuz_block_size, contents[q].size(), NULL);
+        for (size_t c = query_begin[k]; c < query_begin[k + 1]; c++) {
+            const uint32_t r = sdhash_ref[candidates[c].ref];
+            if (r == FUZ_NO_CASCADE_REF) continue;
+            int32_t score = query->compare(sdhash_refs->at(r), 0);
+            if (score >= threshold) buffers[worker].push_back({q, candidates[c].ref, score});
+        }
+        delete query;
+    });
+
+    std::vector<fuz_match> matches = fuz_merge_matches(buffers);
+    cascade_stats.candidates += candidates.size();
+    cascade_stats.hashed += query_begin.size() - 1;
+    cascade_stats.confirmed += matches.size();
+
+    return matches;
+}
+
+// loads all ssdeep hashes from a file into a packed ssdeep store
+inline void fuz_ssdeep_list(const char *fname, fuz_ssdeep_store &store)
 {
     char delim = ',';
     std::string line;
@@ -317,7 +911,7 @@ inline void fuz_ssdeep_list(const char *fname, std::vector <ssdeep_digest *> &ss
             // skip comments 
             if (line[0] == '#') continue;               
             
-            ssdeep_digest *sdg = new ssdeep_digest;
+            std::string hash, name;
             
             stringstream linestream(line);
             std::string item;
@@ -327,11 +921,11 @@ inline void fuz_ssdeep_list(const char *fname, std::vector <ssdeep_digest *> &ss
                 switch(counter) {
                     case 0:
                         // get the hash
-                        strcpy(sdg->hash, item.c_str());
+                        hash = item;
                         break;
                     case 1:
                         // get the filename
-                        sdg->name = item;
+                        name = item;
                         break;
                     default:
                         std::cerr << "Error parsing fingerprint file\n";
@@ -339,7 +933,7 @@ inline void fuz_ssdeep_list(const char *fname, std::vector <ssdeep_digest *> &ss
                 }                   
                 counter++;
               }
-            ssdeep_list.push_back(sdg);
+            store.add(hash.c_str(), name);
         }
     } else {
         std::cerr << "Cannot open: " << fname << "\n";
@@ -356,20 +950,178 @@ inline std::string fuz_ssdeep_list_to_string(const std::vector <ssdeep_digest *>
     return out.str();
 }
 
+// fuzzy_compare of imported digest i and a query on the parsed digests, digests the plugin cannot parse are left to ssdeep
+inline int fuz_ssdeep_score(const fuz_ssdeep_store &store, size_t i, const ssdeep_digest *sdg)
+{
+    if (store.parsed(i) && sdg->parsed.valid) return store.compare(i, sdg->parsed);
+    return fuzzy_compare (store.text(i).c_str(), sdg->hash);
+}
+
 // Compares two ssdeep sets and returns results
-inline std::string fuz_compare_two_ssdeep_lists(const std::vector <ssdeep_digest *> &ssdeep_list1, const std::vector <ssdeep_digest *> &ssdeep_list2, int32_t threshold)
+// ssdeep_list1 holds the imported digests and is split into partitions for the plugin comparison threads
+// with an index of ssdeep_list1 each digest of ssdeep_list2 is only compared with its candidates,
+// a simhash index narrows them down to the digests with a close simhash
+// exact matches are reported with score 100, skipped digests of ssdeep_list2 are not compared at all
+inline std::string fuz_compare_two_ssdeep_lists(const fuz_ssdeep_store &ssdeep_list1, const std::vector <ssdeep_digest *> &ssdeep_list2,
+                                                const fuz_ssdeep_gram_index *index, const fuz_simhash_index *simhash,
+                                                const std::vector<uint64_t> &simhashes, const fuz_exact_hits &exact, int32_t threshold)
 {
-    int score;
     std::stringstream out;
     out.fill('0');
     
-    for(auto &sdg1 : ssdeep_list1) {
-        for(auto &sdg2 : ssdeep_list2) {
-            score = fuzzy_compare (sdg1->hash, sdg2->hash);
-            if (score >= threshold) {
-                out << sdg1->name << fuz_sep << sdg2->name << fuz_sep << setw(3) << score << endl;
+    std::vector<std::vector<fuz_match> > buffers(compare_pool->workers());
+    if (index != NULL || simhash != NULL) {
+        compare_pool->parallel_for(ssdeep_list2.size(), [&](size_t j, unsigned worker) {
+            if (exact.skipped(j)) return;
+            std::vector<uint32_t> candidates;
+            if (index != NULL) {
+                index->candidates(ssdeep_list2[j]->parsed, candidates);
+                ssdeep_stats.candidates += candidates.size();
+            }
+            if (simhash != NULL) {
+                std::vector<uint32_t> close;
+                fuz_simhash_candidates(*simhash, simhashes[j], close);
+                if (index != NULL) {
+                    std::vector<uint32_t> both;
+                    std::set_intersection(candidates.begin(), candidates.end(), close.begin(), close.end(), std::back_inserter(both));
+                    close.swap(both);
+                }
+                candidates.swap(close);
+            }
+
+            for (uint32_t i : candidates) {
+                int score = fuz_ssdeep_score(ssdeep_list1, i, ssdeep_list2[j]);
+                if (score >= threshold) buffers[worker].push_back({(uint32_t)j, i, score});
             }
+        });
+        if (index != NULL) ssdeep_stats.pairs += (uint64_t)ssdeep_list1.size() * ssdeep_list2.size();
+        if (simhash != NULL) simhash_stats.pairs += (uint64_t)ssdeep_list1.size() * ssdeep_list2.size();
+    } else {
+        size_t partitions = (ssdeep_list1.size() + FUZ_SSDEEP_PARTITION_SIZE - 1) / FUZ_SSDEEP_PARTITION_SIZE;
+        compare_pool->parallel_for(partitions, [&](size_t p, unsigned worker) {
+            size_t end1 = MIN(ssdeep_list1.size(), (p + 1) * FUZ_SSDEEP_PARTITION_SIZE);
+            for (size_t i = p * FUZ_SSDEEP_PARTITION_SIZE; i < end1; i++) {
+                for (size_t j = 0; j < ssdeep_list2.size(); j++) {
+                    if (exact.skipped(j)) continue;
+                    int score = fuz_ssdeep_score(ssdeep_list1, i, ssdeep_list2[j]);
+                    if (score >= threshold) buffers[worker].push_back({(uint32_t)j, (uint32_t)i, score});
+                }
+            }
+        });
+    }
+
+    // results are written grouped by the digests of ssdeep_list2
+    for (auto &match : fuz_topk_matches(fuz_merge_exact(fuz_merge_matches(buffers), exact), fuz_topk)) {
+        out << ssdeep_list1.name(match.ref) << fuz_sep << ssdeep_list2[match.query]->name << fuz_sep << setw(3) << match.score << endl;
+    }
+    
+    return out.str();
+}
+
+// loads the chunk hashes of all imported blocks from a file into a new chunk index
+inline void fuz_chunk_list(const char *fname, fuz_chunk_index &index)
+{
+    std::string line;
+    ifstream ifs(fname, ifstream::in|ios::binary);
+    
+    if (ifs.is_open()) {
+        // iterate through each line and parse the chunk hashes
+        while(std::getline(ifs, line)) {
+            if (line.length()==0) break;
+            
+            // skip comments
+            if (line[0] == '#') continue;
+            
+            // block name:count of the chunk hashes:b64 chunk hashes, the name can contain the delimiter
+            const size_t hashes_pos = line.rfind(':');
+            const size_t count_pos = hashes_pos == std::string::npos || hashes_pos == 0 ? std::string::npos : line.rfind(':', hashes_pos - 1);
+            if (count_pos == std::string::npos) {
+                std::cerr << "Error parsing chunk hash file\n";
+                continue;
+            }
+            
+            const int count = atoi(line.c_str() + count_pos + 1);
+            int dec_len = 0;
+            uint64_t *dec_hashes = (uint64_t *)b64decode(&line[hashes_pos + 1], (int)(line.length() - hashes_pos - 1), &dec_len);
+            if (count <= 0 || dec_len != count * (int)sizeof(uint64_t)) {
+                std::cerr << "Error parsing chunk hash file\n";
+                free(dec_hashes);
+                continue;
+            }
+            
+            index.add(line.substr(0, count_pos), std::vector<uint64_t>(dec_hashes, dec_hashes + count));
+            free(dec_hashes);
         }
+    } else {
+        std::cerr << "Cannot open: " << fname << "\n";
+    }
+    index.finalize();
+}
+
+// returns the chunk hashes of blocks as std::string
+inline std::string fuz_chunk_list_to_string(const std::vector<fuz_chunk_block> &blocks)
+{
+    std::stringstream out;
+    for (auto &block : blocks) {
+        char *b64 = b64encode((const char *)block.hashes.data(), (int)(block.hashes.size() * sizeof(uint64_t)));
+        out << block.name << ":" << block.hashes.size() << ":" << b64 << endl;
+        free(b64);
+    }
+    return out.str();
+}
+
+// Compares the chunk hashes of query blocks with the imported chunk index and returns results
+// each query only looks up its own chunks, the imported blocks sharing none of them score 0,
+// with a simhash index only the blocks with a close simhash are scored
+// exact matches are reported with score 100, skipped queries are not compared at all
+inline std::string fuz_compare_chunks(const fuz_chunk_index &index, const fuz_simhash_index *simhash, const std::vector<fuz_chunk_block> &queries,
+                                      const std::vector<uint64_t> &simhashes, const fuz_exact_hits &exact, int32_t threshold)
+{
+    std::stringstream out;
+    out.fill('0');
+    
+    std::vector<std::vector<fuz_match> > buffers(compare_pool->workers());
+    compare_pool->parallel_for(queries.size(), [&](size_t q, unsigned worker) {
+        if (exact.skipped(q)) return;
+        std::vector<uint64_t> distinct(queries[q].hashes);
+        std::vector<std::pair<uint32_t, uint32_t> > counts;
+        fuz_chunk_distinct(distinct);
+        index.shared(distinct, counts);
+        if (simhash != NULL) {
+            std::vector<uint32_t> close;
+            fuz_simhash_candidates(*simhash, simhashes[q], close);
+            std::vector<std::pair<uint32_t, uint32_t> > kept;
+            auto c = close.begin();
+            for (auto &count : counts) {
+                c = std::lower_bound(c, close.end(), count.first);
+                if (c != close.end() && *c == count.first) kept.push_back(count);
+            }
+            counts.swap(kept);
+        }
+        chunk_stats.candidates += counts.size();
+        
+        if (threshold <= 0) {
+            // every pair is reported, the ones without chunks in common with score 0
+            auto c = counts.begin();
+            for (uint32_t r = 0; r < index.size(); r++) {
+                uint32_t shared = 0;
+                if (c != counts.end() && c->first == r) shared = (c++)->second;
+                int score = fuz_chunk_score(shared, distinct.size(), index.chunks[r]);
+                if (score >= threshold) buffers[worker].push_back({(uint32_t)q, r, score});
+            }
+            return;
+        }
+        for (auto &c : counts) {
+            int score = fuz_chunk_score(c.second, distinct.size(), index.chunks[c.first]);
+            if (score >= threshold) buffers[worker].push_back({(uint32_t)q, c.first, score});
+        }
+    });
+    chunk_stats.pairs += (uint64_t)queries.size() * index.size();
+    if (simhash != NULL) simhash_stats.pairs += (uint64_t)queries.size() * index.size();
+    
+    // results are written grouped by query
+    for (auto &match : fuz_topk_matches(fuz_merge_exact(fuz_merge_matches(buffers), exact), fuz_topk)) {
+        out << index.names[match.ref] << fuz_sep << queries[match.query].name << fuz_sep << setw(3) << match.score << endl;
     }
     
     return out.str();
@@ -389,17 +1141,19 @@ void scan_fuzzyblocks(const class scanner_params &sp, const recursion_control_bl
             
             // fuz_mode
             std::stringstream ss_fuz_mode;
-            ss_fuz_mode << "Operational mode [none|import|scan]\n"
-                << "        none    - The scanner is active but performs no action.\n"
-                << "        import  - Import block similarity hashes.\n"
-                << "        scan    - Scan for matching block similiarity hashes.";
+            ss_fuz_mode << "Operational mode [none|import|scan|presence]\n"
+                << "        none     - The scanner is active but performs no action.\n"
+                << "        import   - Import block similarity hashes.\n"
+                << "        scan     - Scan for matching block similiarity hashes.\n"
+                << "        presence - Scan for the imported files and report their coverage per file.";
             sp.info->get_config("fuz_mode", &fuz_mode, ss_fuz_mode.str());
             
             // fuz_hash_type
             std::stringstream ss_fuz_hash_type;
             ss_fuz_hash_type
                 << "Selects the similarity hash algorithm.\n"
-                << "      Currently valid options are 'sdhash-dd' (default), 'sdhash', 'mrshv2' and 'ssdeep'.\n";
+                << "      Currently valid options are 'sdhash-dd' (default), 'sdhash', 'mrshv2', 'ssdeep'\n"
+                << "      and 'mrshv2-chunks' (raw mrshv2 chunk hashes searched through an inverted index).\n";
             sp.info->get_config("fuz_hash_type", &fuz_hash_type, ss_fuz_hash_type.str());
             
             // fuz_block_size
@@ -428,67 +1182,366 @@ void scan_fuzzyblocks(const class scanner_params &sp, const recursion_control_bl
                 << "      Valid only in scan mode (default=fuz_hashfile.txt).";
             sp.info->get_config("fuz_hashfile", &fuz_hashfile, ss_fuz_hashfile.str());
             
-            // fuz_sep
-            std::stringstream ss_fuz_sep;
-            ss_fuz_sep
-                << "Selects the seperator for the score file.\n"
-                << "      Valid only in scan mode (default=\"|\").";
-            sp.info->get_config("fuz_sep", &fuz_sep, ss_fuz_sep.str());
+            // fuz_sep
+            std::stringstream ss_fuz_sep;
+            ss_fuz_sep
+                << "Selects the seperator for the score file.\n"
+                << "      Valid only in scan mode (default=\"|\").";
+            sp.info->get_config("fuz_sep", &fuz_sep, ss_fuz_sep.str());
+            
+            // fuz_threads
+            std::stringstream ss_fuz_threads;
+            ss_fuz_threads
+                << "Selects the amount of plugin threads that compare a single sbuf\n"
+                << "      against partitions of the imported hashes. 0 compares in the\n"
+                << "      bulk_extractor thread. Valid only in scan mode (default=0).";
+            sp.info->get_config("fuz_threads", &fuz_threads, ss_fuz_threads.str());
+            
+            // fuz_compare_threads
+            std::stringstream ss_fuz_compare_threads;
+            ss_fuz_compare_threads
+                << "Selects the amount of plugin threads that compare the hashed sbufs, so the\n"
+                << "      bulk_extractor threads only hash. 0 compares in the bulk_extractor thread.\n"
+                << "      Valid only in scan mode (default=0).";
+            sp.info->get_config("fuz_compare_threads", &fuz_compare_threads, ss_fuz_compare_threads.str());
+            
+            // fuz_compare_queue
+            std::stringstream ss_fuz_compare_queue;
+            ss_fuz_compare_queue
+                << "Selects the amount of hashed sbufs that wait for the fuz_compare_threads, hashing\n"
+                << "      waits while the queue is full. Valid only in scan mode (default=16, minimum=1).";
+            sp.info->get_config("fuz_compare_queue", &fuz_compare_queue, ss_fuz_compare_queue.str());
+            
+            // fuz_lsh
+            std::stringstream ss_fuz_lsh;
+            ss_fuz_lsh
+                << "Compares sdhash and sdhash-dd blocks only with candidates from a MinHash\n"
+                << "      index over the imported filters. Needs fuz_threshold >= 1.\n"
+                << "      Valid only in scan mode (default=false).";
+            sp.info->get_config("fuz_lsh", &fuz_lsh, ss_fuz_lsh.str());
+            
+            // fuz_lsh_recall
+            std::stringstream ss_fuz_lsh_recall;
+            ss_fuz_lsh_recall
+                << "Selects the probability in percent that the index finds a block pair\n"
+                << "      that just reaches fuz_threshold (default=95, 1-99).";
+            sp.info->get_config("fuz_lsh_recall", &fuz_lsh_recall, ss_fuz_lsh_recall.str());
+            
+            // fuz_ssdeep_index
+            std::stringstream ss_fuz_ssdeep_index;
+            ss_fuz_ssdeep_index
+                << "Compares ssdeep blocks only with imported digests of a fitting block size\n"
+                << "      that share a 7 character substring, as needed for a score above 0.\n"
+                << "      Used if fuz_threshold >= 1. Valid only in scan mode (default=true).";
+            sp.info->get_config("fuz_ssdeep_index", &fuz_ssdeep_index, ss_fuz_ssdeep_index.str());
+            
+            // fuz_exact
+            std::stringstream ss_fuz_exact;
+            ss_fuz_exact
+                << "Import: also stores a 128-bit digest of every block in the hashfile.\n"
+                << "      Scan: reports blocks identical to an imported block with score 100,\n"
+                << "      needs a hashfile imported with fuz_exact (default=false).";
+            sp.info->get_config("fuz_exact", &fuz_exact, ss_fuz_exact.str());
+            
+            // fuz_exact_skip
+            std::stringstream ss_fuz_exact_skip;
+            ss_fuz_exact_skip
+                << "Blocks with an exact match are not compared by the similarity hash.\n"
+                << "      Needs fuz_exact. Valid only in scan mode (default=false).";
+            sp.info->get_config("fuz_exact_skip", &fuz_exact_skip, ss_fuz_exact_skip.str());
+            
+            // fuz_mrshv2_engine
+            std::stringstream ss_fuz_mrshv2_engine;
+            ss_fuz_mrshv2_engine
+                << "Selects the search over the imported mrshv2 fingerprints [bucket|slice].\n"
+                << "        bucket  - Skips buckets of similar filters that cannot reach the threshold.\n"
+                << "        slice   - Counts bits in common on bit-sliced filters, reads only the slices\n"
+                << "                  of the bits a block has set. Needs fuz_threshold >= 1.\n"
+                << "      Valid only in scan mode (default=bucket).";
+            sp.info->get_config("fuz_mrshv2_engine", &fuz_mrshv2_engine, ss_fuz_mrshv2_engine.str());
+            
+            // fuz_mrshv2_fold
+            std::stringstream ss_fuz_mrshv2_fold;
+            ss_fuz_mrshv2_fold
+                << "Checks every mrshv2 pair of the bucket engine against a 64 byte fold of the imported filter\n"
+                << "      before the full filters are compared. Needs fuz_threshold >= 1.\n"
+                << "      Valid only in scan mode (default=false).";
+            sp.info->get_config("fuz_mrshv2_fold", &fuz_mrshv2_fold, ss_fuz_mrshv2_fold.str());
+            
+            // fuz_batch
+            std::stringstream ss_fuz_batch;
+            ss_fuz_batch
+                << "Collects the mrshv2 blocks of several sbufs until at least this many are hashed\n"
+                << "      and compares them in one pass over the imported hashes. 0 compares every sbuf\n"
+                << "      on its own. Valid only in scan mode (default=0).";
+            sp.info->get_config("fuz_batch", &fuz_batch, ss_fuz_batch.str());
+            
+            // fuz_predict
+            std::stringstream ss_fuz_predict;
+            ss_fuz_predict
+                << "Compares only every 16th mrshv2 block of a run with all imported blocks and predicts\n"
+                << "      that the blocks behind a match match the following imported blocks of the same\n"
+                << "      file. Needs fuz_threshold >= 1. Valid only in scan mode (default=false).";
+            sp.info->get_config("fuz_predict", &fuz_predict, ss_fuz_predict.str());
+            
+            // fuz_cascade_hashfile
+            std::stringstream ss_fuz_cascade_hashfile;
+            ss_fuz_cascade_hashfile
+                << "Path to sdhash-dd hashes of the blocks in fuz_hashfile. mrshv2 blocks scoring at\n"
+                << "      least fuz_cascade_threshold are scored with sdhash-dd, which gives the reported\n"
+                << "      score. Valid only for mrshv2 in scan mode (default=\"\").";
+            sp.info->get_config("fuz_cascade_hashfile", &fuz_cascade_hashfile, ss_fuz_cascade_hashfile.str());
+            
+            // fuz_cascade_threshold
+            std::stringstream ss_fuz_cascade_threshold;
+            ss_fuz_cascade_threshold
+                << "Selects the mrshv2 score a block pair needs for the sdhash-dd score of a cascade.\n"
+                << "      Valid only in scan mode (default=1, 1-100).";
+            sp.info->get_config("fuz_cascade_threshold", &fuz_cascade_threshold, ss_fuz_cascade_threshold.str());
+            
+            // fuz_presence_coverage
+            std::stringstream ss_fuz_presence_coverage;
+            ss_fuz_presence_coverage
+                << "Selects the percentage of the blocks of an imported file that have to match until the file\n"
+                << "      counts as present and its blocks are no longer compared.\n"
+                << "      Valid only in presence mode (default=50, 1-100).";
+            sp.info->get_config("fuz_presence_coverage", &fuz_presence_coverage, ss_fuz_presence_coverage.str());
+            
+            // fuz_presence_hits
+            std::stringstream ss_fuz_presence_hits;
+            ss_fuz_presence_hits
+                << "Selects the amount of matches after which an imported file also counts as present.\n"
+                << "      Valid only in presence mode (default=0, only fuz_presence_coverage).";
+            sp.info->get_config("fuz_presence_hits", &fuz_presence_hits, ss_fuz_presence_hits.str());
+            
+            // fuz_topk
+            std::stringstream ss_fuz_topk;
+            ss_fuz_topk
+                << "Reports only the best fuz_topk matches of every block, pairs that cannot be among them\n"
+                << "      are skipped early. Valid only in scan mode (default=0, all matches).";
+            sp.info->get_config("fuz_topk", &fuz_topk, ss_fuz_topk.str());
+            
+            // fuz_topk_ref
+            std::stringstream ss_fuz_topk_ref;
+            ss_fuz_topk_ref
+                << "Keeps the best fuz_topk matches of every imported block over the whole scan instead,\n"
+                << "      they are written at the end of the scan. Valid only for mrshv2 in scan mode (default=false).";
+            sp.info->get_config("fuz_topk_ref", &fuz_topk_ref, ss_fuz_topk_ref.str());
+            
+            // fuz_simhash
+            std::stringstream ss_fuz_simhash;
+            ss_fuz_simhash
+                << "Import: also stores a 64-bit SimHash over the mrshv2 chunks of every block.\n"
+                << "      Scan: compares blocks only with imported blocks within fuz_simhash_radius,\n"
+                << "      needs a hashfile imported with fuz_simhash and fuz_threshold >= 1 (default=false).";
+            sp.info->get_config("fuz_simhash", &fuz_simhash, ss_fuz_simhash.str());
+            
+            // fuz_simhash_radius
+            std::stringstream ss_fuz_simhash_radius;
+            ss_fuz_simhash_radius
+                << "Selects the maximum number of differing SimHash bits of a candidate.\n"
+                << "      Valid only in scan mode (default=10, 0-15).";
+            sp.info->get_config("fuz_simhash_radius", &fuz_simhash_radius, ss_fuz_simhash_radius.str());
+            
+            // fuz_sdhash_index
+            std::stringstream ss_fuz_sdhash_index;
+            ss_fuz_sdhash_index
+                << "Import: writes an sdhash bloom filter index over the features of all blocks to this file.\n"
+                << "      Scan: loads the index and compares only blocks with features in it,\n"
+                << "      needs fuz_threshold >= 1. Valid only for sdhash-dd (default=\"\", no index).";
+            sp.info->get_config("fuz_sdhash_index", &fuz_sdhash_index, ss_fuz_sdhash_index.str());
+            
+            // fuz_sdhash_scorer
+            std::stringstream ss_fuz_sdhash_scorer;
+            ss_fuz_sdhash_scorer
+                << "Selects the scorer of sdhash-dd block pairs [sdhash|plugin|verify].\n"
+                << "        sdhash  - sdbf::compare of the sdhash library.\n"
+                << "        plugin  - Vectorized scorer of the plugin with the same scores, skips pairs\n"
+                << "                  that cannot reach fuz_threshold early.\n"
+                << "        verify  - Reports the sdhash scores and counts the pairs the plugin scores differently.\n"
+                << "      Valid only in scan mode (default=sdhash).";
+            sp.info->get_config("fuz_sdhash_scorer", &fuz_sdhash_scorer, ss_fuz_sdhash_scorer.str());
+            
+            // configure the "feature" output file depending on mode
+            if (fuz_mode == "import") {
+                sp.info->feature_names.insert("fuz_hashes");
+            }
+            
+            if (fuz_mode == "scan") {
+                sp.info->feature_names.insert("fuz_scores");
+            }
+            
+            if (fuz_mode == "presence") {
+                sp.info->feature_names.insert("fuz_presence");
+            }
+            
+            return;
+        }
+
+        // init
+        case scanner_params::PHASE_INIT: {
+            // validate the input parameters
+
+            // fuz_mode
+            if (fuz_mode == "none") {
+                scanner_mode = MODE_NONE;
+            } else if (fuz_mode == "import") {
+                scanner_mode = MODE_IMPORT;
+            } else if (fuz_mode == "scan" || fuz_mode == "presence") {
+                scanner_mode = MODE_SCAN;
+            } else {
+                // bad mode
+                std::cerr << "Error.  Parameter 'fuz_mode' value '"
+                          << fuz_mode << "' must be [none|import|scan|presence].\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+
+            // fuz_hash_type
+            if (fuz_hash_type != "sdhash-dd" && fuz_hash_type != "sdhash" && fuz_hash_type != "mrshv2" && fuz_hash_type != "ssdeep" &&
+                fuz_hash_type != "mrshv2-chunks") {
+                std::cerr << "Error.  Value for parameter 'fuz_hash_type' is invalid.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_block_size
+            if (fuz_block_size < 512) {
+                std::cerr << "Error.  Value for parameter 'fuz_block_size' is invalid.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+
+            // fuz_step_size
+            if (fuz_step_size == 0) {
+                std::cerr << "Error.  Value for parameter 'fuz_step_size' is invalid.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            if (fuz_step_size == 0) {
+                std::cerr << "Error.  Value for parameter 'fuz_step_size' is invalid.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_lsh
+            if (fuz_lsh && (fuz_threshold < 1 || fuz_lsh_recall < 1 || fuz_lsh_recall > 99)) {
+                std::cerr << "Error.  Parameter 'fuz_lsh' needs fuz_threshold >= 1 and fuz_lsh_recall in [1, 99].\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_mrshv2_engine
+            if (fuz_mrshv2_engine != "bucket" && fuz_mrshv2_engine != "slice") {
+                std::cerr << "Error.  Parameter 'fuz_mrshv2_engine' value '"
+                          << fuz_mrshv2_engine << "' must be [bucket|slice].\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            if (fuz_mrshv2_engine == "slice" && fuz_threshold < 1) {
+                std::cerr << "Error.  Parameter 'fuz_mrshv2_engine' value 'slice' needs fuz_threshold >= 1.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_mrshv2_fold
+            if (fuz_mrshv2_fold && (fuz_mrshv2_engine != "bucket" || fuz_threshold < 1)) {
+                std::cerr << "Error.  Parameter 'fuz_mrshv2_fold' needs fuz_mrshv2_engine=bucket and fuz_threshold >= 1.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_compare_queue
+            if (fuz_compare_queue == 0) {
+                std::cerr << "Error.  Value for parameter 'fuz_compare_queue' is invalid.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_batch
+            if (scanner_mode == MODE_SCAN && fuz_batch != 0 && fuz_hash_type != "mrshv2") {
+                std::cerr << "Error.  Parameter 'fuz_batch' is only supported for fuz_hash_type=mrshv2.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_predict
+            if (scanner_mode == MODE_SCAN && fuz_predict && (fuz_hash_type != "mrshv2" || fuz_threshold < 1)) {
+                std::cerr << "Error.  Parameter 'fuz_predict' needs fuz_hash_type=mrshv2 and fuz_threshold >= 1.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_cascade_hashfile
+            if (scanner_mode == MODE_SCAN && !fuz_cascade_hashfile.empty() &&
+                (fuz_hash_type != "mrshv2" || fuz_cascade_threshold < 1 || fuz_cascade_threshold > 100)) {
+                std::cerr << "Error.  Parameter 'fuz_cascade_hashfile' needs fuz_hash_type=mrshv2 and fuz_cascade_threshold in [1, 100].\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_presence_coverage
+            if (fuz_mode == "presence" && (fuz_hash_type != "mrshv2" || fuz_presence_coverage < 1 || fuz_presence_coverage > 100)) {
+                std::cerr << "Error.  Parameter 'fuz_mode' value 'presence' needs fuz_hash_type=mrshv2 and fuz_presence_coverage in [1, 100].\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            
+            // fuz_topk
+            if (fuz_topk != 0 && fuz_mode == "presence") {
+                std::cerr << "Error.  Parameter 'fuz_topk' is not supported in presence mode.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
             
-            // configure the "feature" output file depending on mode
-            if (fuz_mode == "import") {
-                sp.info->feature_names.insert("fuz_hashes");
+            // fuz_topk_ref
+            if (scanner_mode == MODE_SCAN && fuz_topk_ref && (fuz_hash_type != "mrshv2" || fuz_topk == 0)) {
+                std::cerr << "Error.  Parameter 'fuz_topk_ref' needs fuz_hash_type=mrshv2 and fuz_topk >= 1.\n"
+                          << "Cannot continue.\n";
+                exit(1);
             }
             
-            if (fuz_mode == "scan") {
-                sp.info->feature_names.insert("fuz_scores");
+            // fuz_exact_skip
+            if (fuz_exact_skip && !fuz_exact) {
+                std::cerr << "Error.  Parameter 'fuz_exact_skip' needs fuz_exact.\n"
+                          << "Cannot continue.\n";
+                exit(1);
             }
             
-            return;
-        }
-
-        // init
-        case scanner_params::PHASE_INIT: {
-            // validate the input parameters
-
-            // fuz_mode
-            if (fuz_mode == "none") {
-                scanner_mode = MODE_NONE;
-            } else if (fuz_mode == "import") {
-                scanner_mode = MODE_IMPORT;
-            } else if (fuz_mode == "scan") {
-                scanner_mode = MODE_SCAN;
-            } else {
-                // bad mode
-                std::cerr << "Error.  Parameter 'fuz_mode' value '"
-                          << fuz_mode << "' must be [none|import|scan].\n"
+            // fuz_simhash
+            if (scanner_mode == MODE_SCAN && fuz_simhash && (fuz_threshold < 1 || fuz_simhash_radius > FUZ_SIMHASH_MAX_RADIUS)) {
+                std::cerr << "Error.  Parameter 'fuz_simhash' needs fuz_threshold >= 1 and fuz_simhash_radius in [0, "
+                          << FUZ_SIMHASH_MAX_RADIUS << "].\n"
                           << "Cannot continue.\n";
                 exit(1);
             }
-
-            // fuz_hash_type
-            if (fuz_hash_type != "sdhash-dd" && fuz_hash_type != "sdhash" && fuz_hash_type != "mrshv2" && fuz_hash_type != "ssdeep") {
-                std::cerr << "Error.  Value for parameter 'fuz_hash_type' is invalid.\n"
+            if (fuz_simhash && fuz_lsh) {
+                std::cerr << "Error.  Parameters 'fuz_simhash' and 'fuz_lsh' cannot be combined.\n"
                           << "Cannot continue.\n";
                 exit(1);
             }
             
-            // fuz_block_size
-            if (fuz_block_size < 512) {
-                std::cerr << "Error.  Value for parameter 'fuz_block_size' is invalid.\n"
+            // fuz_sdhash_index
+            if (!fuz_sdhash_index.empty() && fuz_hash_type != "sdhash-dd") {
+                std::cerr << "Error.  Parameter 'fuz_sdhash_index' is valid only for fuz_hash_type sdhash-dd.\n"
                           << "Cannot continue.\n";
                 exit(1);
             }
-
-            // fuz_step_size
-            if (fuz_step_size == 0) {
-                std::cerr << "Error.  Value for parameter 'fuz_step_size' is invalid.\n"
+            if (scanner_mode == MODE_SCAN && !fuz_sdhash_index.empty() && fuz_threshold < 1) {
+                std::cerr << "Error.  Parameter 'fuz_sdhash_index' needs fuz_threshold >= 1 in scan mode.\n"
                           << "Cannot continue.\n";
                 exit(1);
             }
             
-            if (fuz_step_size == 0) {
-                std::cerr << "Error.  Value for parameter 'fuz_step_size' is invalid.\n"
+            // fuz_sdhash_scorer
+            if (fuz_sdhash_scorer != "sdhash" && fuz_sdhash_scorer != "plugin" && fuz_sdhash_scorer != "verify") {
+                std::cerr << "Error.  Parameter 'fuz_sdhash_scorer' set to '" << fuz_sdhash_scorer << "' is invalid.\n"
+                          << "Cannot continue.\n";
+                exit(1);
+            }
+            if (fuz_sdhash_scorer != "sdhash" && fuz_hash_type != "sdhash-dd") {
+                std::cerr << "Error.  Parameter 'fuz_sdhash_scorer' is valid only for fuz_hash_type sdhash-dd.\n"
                           << "Cannot continue.\n";
                 exit(1);
             }
@@ -523,6 +1576,13 @@ void scan_fuzzyblocks(const class scanner_params &sp, const recursion_control_bl
                         mode->path_list_compare = false;
                     }
                     
+                    // sdhash inserts the features of every block into the index
+                    if (!fuz_sdhash_index.empty()) {
+                        sdhash_info = new index_info();
+                        sdhash_info->index = new bloom_filter(FUZ_SDHASH_INDEX_SIZE, 5, 0, 0.0);
+                        std::cout << "sdhash index: " << fuz_sdhash_index << std::endl;
+                    }
+                    
                     return;
                 }
 
@@ -530,17 +1590,81 @@ void scan_fuzzyblocks(const class scanner_params &sp, const recursion_control_bl
                     // show relevant settable options
                     std::cout << "Plugin: scan_fuzzyblocks\n"
                               << "Mode: scan\n"
-                              << "Hashing Scheme: " << fuz_hash_type << std::endl;
+                              << "Hashing Scheme: " << fuz_hash_type << "\n"
+                              << "Comparison threads: " << fuz_threads << "\n"
+                              << "Sbuf comparison threads: " << fuz_compare_threads << std::endl;
+                    
+                    compare_pool = new fuz_pool(fuz_threads);
+                    if (fuz_compare_threads != 0) compare_queue = new fuz_job_queue(fuz_compare_threads, fuz_compare_queue);
+                    
+                    // names of the imported blocks in the order of their refs, for the side signatures
+                    std::vector<std::string> names;
                     
                     if (fuz_hash_type == "sdhash-dd" || fuz_hash_type == "sdhash") {
                         // loads all sdbfs from a file into a new set
-                        imported_sdhash = new sdbf_set();
-                        fuz_sdbf_set(fuz_hashfile.c_str(), imported_sdhash);
-                        if (imported_sdhash->empty()) {
+                        // the plugin scorer reads a flat store of the imported blocks, sdbf objects are only
+                        // loaded for the sdhash scorer and the sdhash feature index
+                        if (fuz_sdhash_scorer != "sdhash") imported_sdhash_store = new fuz_sdbf_store();
+                        if (fuz_sdhash_scorer != "plugin" || !fuz_sdhash_index.empty()) imported_sdhash = new sdbf_set();
+                        fuz_sdbf_set(fuz_hashfile.c_str(), imported_sdhash, imported_sdhash_store);
+                        if ((imported_sdhash != NULL && imported_sdhash->empty()) ||
+                            (imported_sdhash_store != NULL && imported_sdhash_store->size() == 0)) {
                             std::cerr << "Empty imported_sdhash\n";
-                            delete imported_sdhash;
                             exit(1);
                         }
+                        if (imported_sdhash_store != NULL) {
+                            std::cout << "sdbf scorer: " << fuz_sdhash_scorer << ", kernel: " << fuz_sdbf_kernel_name()
+                                      << ", filters: " << imported_sdhash_store->filter_total << std::endl;
+                        }
+                        
+                        // sdhash looks up the features of every query block in the imported index
+                        if (!fuz_sdhash_index.empty()) {
+                            ifstream index_file(fuz_sdhash_index.c_str(), ifstream::in|ios::binary);
+                            if (!index_file.is_open()) {
+                                std::cerr << "Error.  Cannot open sdhash index '" << fuz_sdhash_index << "'.\n"
+                                          << "Cannot continue.\n";
+                                exit(1);
+                            }
+                            index_file.close();
+                            
+                            sdhash_index_list.push_back(new bloom_filter(fuz_sdhash_index));
+                            sdhash_index_sets.push_back(imported_sdhash);
+                            sdhash_info = new index_info();
+                            sdhash_info->indexlist = &sdhash_index_list;
+                            sdhash_info->setlist = &sdhash_index_sets;
+                            sdhash_info->search_first = true;
+                            std::cout << "sdhash index features: " << sdhash_index_list[0]->elem_count() << std::endl;
+                        }
+                        
+                        if (fuz_lsh) {
+                            imported_sdhash_lsh = new fuz_lsh_index();
+                            if (imported_sdhash_store != NULL) {
+                                const fuz_sdbf_store &store = *imported_sdhash_store;
+                                fuz_lsh_build([&](const std::function<void(uint32_t, const uint8_t *)> &visit) {
+                                    for (uint32_t n = 0; n < store.size(); n++) {
+                                        for (uint32_t f = 0; f < store.filter_count[n]; f++) visit(n, store.filter(store.first_filter[n] + f));
+                                    }
+                                }, *imported_sdhash_lsh, fuz_threshold, fuz_lsh_recall);
+                            } else {
+                                fuz_lsh_build([&](const std::function<void(uint32_t, const uint8_t *)> &visit) {
+                                    for (uint32_t n = 0; n < imported_sdhash->size(); n++) {
+                                        for (uint32_t f = 0; f < imported_sdhash->at(n)->filter_count(); f++) {
+                                            uint8_t *filter = imported_sdhash->at(n)->clone_filter(f);
+                                            visit(n, filter);
+                                            free(filter);
+                                        }
+                                    }
+                                }, *imported_sdhash_lsh, fuz_threshold, fuz_lsh_recall);
+                            }
+                        }
+                        
+                        if (fuz_exact || fuz_simhash) {
+                            if (imported_sdhash_store != NULL) {
+                                for (uint32_t n = 0; n < imported_sdhash_store->size(); n++) names.push_back(imported_sdhash_store->name(n));
+                            } else {
+                                for (uint32_t n = 0; n < imported_sdhash->size(); n++) names.push_back(imported_sdhash->at(n)->name());
+                            }
+                        }
                     }
                     
                     if (fuz_hash_type == "mrshv2") {
@@ -558,26 +1682,138 @@ void scan_fuzzyblocks(const class scanner_params &sp, const recursion_control_bl
                         mode->file_comparison = false;
                         mode->helpmessage = false;
                         mode->print = false;
-                        mode->threshold = fuz_threshold;
+                        mode->threshold = fuz_cascade_hashfile.empty() ? fuz_threshold : fuz_cascade_threshold;
                         mode->recursive = false;
                         mode->path_list_compare = false;
                         
-                        // loads all fingerprints from a file into a new set
-                        imported_mrshv2 = init_empty_fingerprintList();
-                        fuz_fp_list(fuz_hashfile.c_str(), imported_mrshv2);
-                        if (imported_mrshv2->size == 0) {
+                        std::cout << "Popcount kernel: " << and_popcount_kernel_name() << std::endl;
+
+                        // loads all fingerprints from a file into a new store
+                        imported_mrshv2 = new fuz_fp_store();
+                        fuz_fp_list(fuz_hashfile.c_str(), *imported_mrshv2);
+                        if (imported_mrshv2->size() == 0) {
                             std::cerr << "Empty imported_mrshv2\n";
-                            fingerprintList_destroy(imported_mrshv2);
+                            delete imported_mrshv2;
                             exit(1);
                         } 
+
+                        // order the fingerprints for threshold-aware comparison
+                        imported_mrshv2->order_for_search();
+                        
+                        if (fuz_batch != 0) mrshv2_batch = new fuz_fp_batch();
+                        
+                        // sdhash-dd digests of the cascade, found by the names of the imported blocks
+                        if (!fuz_cascade_hashfile.empty()) {
+                            imported_sdhash = new sdbf_set();
+                            fuz_sdbf_set(fuz_cascade_hashfile.c_str(), imported_sdhash, NULL);
+                            std::unordered_map<std::string, uint32_t> sdhash_names;
+                            for (uint32_t n = 0; n < imported_sdhash->size(); n++) sdhash_names[imported_sdhash->at(n)->name()] = n;
+                            cascade_refs.assign(imported_mrshv2->size(), FUZ_NO_CASCADE_REF);
+                            for (size_t n = 0; n < imported_mrshv2->size(); n++) {
+                                auto it = sdhash_names.find(imported_mrshv2->name(n));
+                                if (it != sdhash_names.end()) cascade_refs[n] = it->second;
+                            }
+                            std::cout << "Cascade sdhash-dd digests: " << imported_sdhash->size() << ", mrshv2 blocks without one: "
+                                      << std::count(cascade_refs.begin(), cascade_refs.end(), FUZ_NO_CASCADE_REF) << std::endl;
+                        }
+                        
+                        if (fuz_predict) {
+                            imported_mrshv2_successors = new std::vector<uint32_t>(fuz_fp_successors(*imported_mrshv2, fuz_step_size));
+                            std::cout << "mrshv2 blocks with a successor: "
+                                      << imported_mrshv2->size() - std::count(imported_mrshv2_successors->begin(),
+                                                                              imported_mrshv2_successors->end(), FUZ_NO_SUCCESSOR)
+                                      << std::endl;
+                        }
+                        
+                        // imported blocks named <file>-<offset> belong to <file>, blocks with other names are files of their own
+                        if (fuz_mode == "presence") {
+                            std::vector<std::string> files(imported_mrshv2->size());
+                            for (size_t n = 0; n < imported_mrshv2->size(); n++) {
+                                size_t length = 0;
+                                uint64_t offset = 0;
+                                const char *name = imported_mrshv2->name(n);
+                                files[n] = fuz_block_offset(name, length, offset) ? std::string(name, length) : std::string(name);
+                            }
+                            mrshv2_presence = new fuz_presence(files, fuz_presence_coverage, fuz_presence_hits);
+                            std::cout << "Presence files: " << mrshv2_presence->files() << std::endl;
+                        }
+                        
+                        if (fuz_topk_ref) mrshv2_topk_refs = new fuz_topk_refs(imported_mrshv2->size(), fuz_topk);
+                        
+                        if (fuz_mrshv2_fold) {
+                            imported_mrshv2->build_folds();
+                            std::cout << "mrshv2 fold kernel: " << fuz_fold_kernel_name() << std::endl;
+                        }
+                        
+                        if (fuz_mrshv2_engine == "slice") {
+                            imported_mrshv2_slices = new fuz_fp_slices();
+                            imported_mrshv2_slices->build(*imported_mrshv2);
+                            std::cout << "mrshv2 slice words: " << imported_mrshv2_slices->words << std::endl;
+                        }
+                        
+                        if (fuz_exact || fuz_simhash) {
+                            for (size_t n = 0; n < imported_mrshv2->size(); n++) names.push_back(imported_mrshv2->name(n));
+                        }
                     }
                     
                     if (fuz_hash_type == "ssdeep") {
-                        fuz_ssdeep_list(fuz_hashfile.c_str(), imported_ssdeep);
-                        if (imported_ssdeep.size() == 0) {
+                        imported_ssdeep = new fuz_ssdeep_store();
+                        fuz_ssdeep_list(fuz_hashfile.c_str(), *imported_ssdeep);
+                        if (imported_ssdeep->size() == 0) {
                             std::cerr << "Empty imported_ssdeep\n";
                             exit(1);
                         }
+                        std::cout << "ssdeep digests: " << imported_ssdeep->size() << ", " << imported_ssdeep->bytes() << " bytes" << std::endl;
+                        
+                        // a score of 0 has to be reported for every pair below threshold 1
+                        if (fuz_ssdeep_index && fuz_threshold >= 1) {
+                            imported_ssdeep_index = new fuz_ssdeep_gram_index();
+                            fuz_ssdeep_digest digest;
+                            for (size_t i = 0; i < imported_ssdeep->size(); i++) {
+                                imported_ssdeep->unpack(i, digest);
+                                imported_ssdeep_index->add(i, digest);
+                            }
+                            imported_ssdeep_index->finalize();
+                        }
+                        
+                        if (fuz_exact || fuz_simhash) {
+                            for (size_t i = 0; i < imported_ssdeep->size(); i++) names.push_back(imported_ssdeep->name(i));
+                        }
+                    }
+                    
+                    if (fuz_hash_type == "mrshv2-chunks") {
+                        // loads the chunk hashes of all imported blocks into an inverted index
+                        imported_chunks = new fuz_chunk_index();
+                        fuz_chunk_list(fuz_hashfile.c_str(), *imported_chunks);
+                        if (imported_chunks->size() == 0) {
+                            std::cerr << "Empty imported_chunks\n";
+                            delete imported_chunks;
+                            exit(1);
+                        }
+                        
+                        if (fuz_exact || fuz_simhash) names = imported_chunks->names;
+                    }
+                    
+                    if (fuz_exact) {
+                        imported_exact = new fuz_exact_index();
+                        fuz_exact_list(fuz_hashfile.c_str(), names, *imported_exact);
+                        if (imported_exact->size() == 0) {
+                            std::cerr << "Error.  Parameter 'fuz_exact' needs a hashfile imported with fuz_exact.\n"
+                                      << "Cannot continue.\n";
+                            exit(1);
+                        }
+                        std::cout << "Exact digests: " << imported_exact->size() << std::endl;
+                    }
+                    
+                    if (fuz_simhash) {
+                        imported_simhash = new fuz_simhash_index(fuz_simhash_radius);
+                        fuz_simhash_list(fuz_hashfile.c_str(), names, *imported_simhash);
+                        if (imported_simhash->size() == 0) {
+                            std::cerr << "Error.  Parameter 'fuz_simhash' needs a hashfile imported with fuz_simhash.\n"
+                                      << "Cannot continue.\n";
+                            exit(1);
+                        }
+                        std::cout << "Simhashes: " << imported_simhash->size() << ", radius: " << imported_simhash->radius << std::endl;
                     }
                     
                     return;
@@ -611,6 +1847,10 @@ void scan_fuzzyblocks(const class scanner_params &sp, const recursion_control_bl
                         do_ssdeep_import(sp, rcb);
                         return;
                     }
+                    if (fuz_hash_type == "mrshv2-chunks") {
+                        do_chunks_import(sp, rcb);
+                        return;
+                    }
                 case MODE_SCAN:
                     if (fuz_hash_type == "sdhash-dd" || fuz_hash_type == "sdhash") {
                         do_sdhash_scan(sp, rcb);
@@ -624,6 +1864,10 @@ void scan_fuzzyblocks(const class scanner_params &sp, const recursion_control_bl
                         do_ssdeep_scan(sp, rcb);
                         return;
                     }
+                    if (fuz_hash_type == "mrshv2-chunks") {
+                        do_chunks_scan(sp, rcb);
+                        return;
+                    }
                 default:
                     // the user should have just left the scanner disabled.
                     // no action.
@@ -638,18 +1882,126 @@ void scan_fuzzyblocks(const class scanner_params &sp, const recursion_control_bl
                     if (fuz_hash_type == "mrshv2") {
                         free(mode);
                     }
+                    if (sdhash_info != NULL) {
+                        if (sdhash_info->index->write_out(fuz_sdhash_index) != 0) {
+                            std::cerr << "Cannot write sdhash index: " << fuz_sdhash_index << "\n";
+                        }
+                        std::cout << "sdhash index features: " << sdhash_info->index->elem_count() << std::endl;
+                        delete sdhash_info->index;
+                        delete sdhash_info;
+                    }
                     return;
                 case MODE_SCAN:
-                    if (fuz_hash_type == "sdhash") {
+                    // the last batch is compared while the threads still run
+                    if (mrshv2_batch != NULL) {
+                        if (mrshv2_batch->queries.size() != 0) {
+                            fuz_compare_fp_batch(mrshv2_presence == NULL ? sp.fs.get_name("fuz_scores") : NULL, *mrshv2_batch);
+                        }
+                        std::cout << "mrshv2 batches: " << mrshv2_batches << std::endl;
+                        delete mrshv2_batch;
+                    }
+                    if (compare_queue != NULL) {
+                        // jobs still waiting when hashing ended, the comparisons the scan has to wait for
+                        const size_t queued_at_end = compare_queue->depth();
+                        compare_queue->drain();
+                        std::cout << "Sbuf comparison jobs: " << compare_queue->stats.jobs
+                                  << ", max queued: " << compare_queue->stats.max_depth
+                                  << ", queued at the end of hashing: " << queued_at_end
+                                  << ", hashing waited: " << compare_queue->stats.waits << std::endl;
+                        delete compare_queue;
+                    }
+                    // no comparison runs anymore, stop the threads first
+                    delete compare_pool;
+                    if (imported_exact != NULL) {
+                        std::cout << "Exact matches: " << exact_stats.matches
+                                  << ", skipped blocks: " << exact_stats.skipped << std::endl;
+                        delete imported_exact;
+                    }
+                    if (imported_simhash != NULL) {
+                        std::cout << "Simhash candidates: " << simhash_stats.candidates
+                                  << " of " << simhash_stats.pairs << " pairs" << std::endl;
+                        delete imported_simhash;
+                    }
+                    if (imported_sdhash_lsh != NULL) {
+                        std::cout << "sdhash LSH candidates: " << sdhash_lsh_stats.candidates
+                                  << " of " << sdhash_lsh_stats.pairs << " pairs, ratio: "
+                                  << (sdhash_lsh_stats.pairs ? (double)sdhash_lsh_stats.candidates / sdhash_lsh_stats.pairs : 0) << std::endl;
+                        delete imported_sdhash_lsh;
+                    }
+                    if (sdhash_info != NULL) {
+                        std::cout << "sdhash index rejected blocks: " << sdhash_index_stats.rejected
+                                  << " of " << sdhash_index_stats.blocks << std::endl;
+                        for (auto &index : sdhash_index_list) delete index;
+                        delete sdhash_info;
+                    }
+                    if (imported_sdhash_store != NULL) {
+                        if (fuz_sdhash_scorer == "verify") {
+                            std::cout << "sdbf scorer mismatches: " << sdhash_scorer_stats.mismatches
+                                      << " of " << sdhash_scorer_stats.pairs << " pairs" << std::endl;
+                        }
+                        delete imported_sdhash_store;
+                    }
+                    if (imported_sdhash != NULL) {
                         for (uint32_t n = 0; n < imported_sdhash->size(); n++) delete imported_sdhash->at(n);                       
                         delete imported_sdhash;
                     }
                     if (fuz_hash_type == "mrshv2") {
-                        fingerprintList_destroy(imported_mrshv2);
+                        std::cout << "mrshv2 pairs: " << mrshv2_stats.pairs
+                                  << ", pruned by query: " << mrshv2_stats.pruned_query
+                                  << ", pruned by bucket: " << mrshv2_stats.pruned_bucket
+                                  << ", pruned by bound: " << mrshv2_stats.pruned_bound
+                                  << ", pruned by fold: " << mrshv2_stats.pruned_fold
+                                  << ", pruned by slices: " << mrshv2_stats.pruned_slices << std::endl;
+                        if (!cascade_refs.empty()) {
+                            std::cout << "Cascade candidates: " << cascade_stats.candidates
+                                      << ", hashed blocks: " << cascade_stats.hashed
+                                      << ", confirmed: " << cascade_stats.confirmed << std::endl;
+                        }
+                        if (mrshv2_topk_refs != NULL) {
+                            std::stringstream out;
+                            out.fill('0');
+                            mrshv2_topk_refs->for_each([&out](uint32_t ref, const std::string &query, int score) {
+                                out << imported_mrshv2->name(ref) << fuz_sep << query << fuz_sep << setw(3) << score << std::endl;
+                            });
+                            std::string fuz_results = out.str();
+                            if (!fuz_results.empty()) {
+                                fuz_results.erase(fuz_results.end()-1);
+                                sp.fs.get_name("fuz_scores")->write(fuz_results);
+                            }
+                            delete mrshv2_topk_refs;
+                        }
+                        if (mrshv2_presence != NULL) {
+                            std::string report = mrshv2_presence->report(fuz_sep);
+                            if (!report.empty()) {
+                                report.erase(report.end()-1);
+                                sp.fs.get_name("fuz_presence")->write(report);
+                            }
+                            std::cout << "Presence files: " << mrshv2_presence->satisfied() << " of " << mrshv2_presence->files()
+                                      << " present, pairs skipped: " << mrshv2_presence->skipped << std::endl;
+                            delete mrshv2_presence;
+                        }
+                        if (imported_mrshv2_successors != NULL) {
+                            std::cout << "mrshv2 seeds: " << mrshv2_predict_stats.seeds
+                                      << ", predictions confirmed: " << mrshv2_predict_stats.confirmed
+                                      << " of " << mrshv2_predict_stats.predicted << std::endl;
+                            delete imported_mrshv2_successors;
+                        }
+                        delete imported_mrshv2_slices;
+                        delete imported_mrshv2;
                         free(mode);
                     }
                     if (fuz_hash_type == "ssdeep") {
-                        for(auto &dig : imported_ssdeep) delete dig;
+                        if (imported_ssdeep_index != NULL) {
+                            std::cout << "ssdeep candidates: " << ssdeep_stats.candidates
+                                      << " of " << ssdeep_stats.pairs << " pairs" << std::endl;
+                            delete imported_ssdeep_index;
+                        }
+                        delete imported_ssdeep;
+                    }
+                    if (fuz_hash_type == "mrshv2-chunks") {
+                        std::cout << "mrshv2-chunks candidates: " << chunk_stats.candidates
+                                  << " of " << chunk_stats.pairs << " pairs" << std::endl;
+                        delete imported_chunks;
                     }
                     return;
                 default:
@@ -690,6 +2042,9 @@ static void do_sdhash_import(const class scanner_params &sp, const recursion_con
     
     // create vector that stores pointers to the sdbf hash names
     std::vector <string *> sdnames;
+    
+    // side signature lines of the blocks
+    std::string side_str;
         
     if(fuz_sdhash_dd) {
         // iterate through the blocks of the sbuf and hash each block
@@ -705,10 +2060,14 @@ static void do_sdhash_import(const class scanner_params &sp, const recursion_con
             
             // sdbf name = filepath/filename + sbuf forensic path +  block sbuf offset
             sdnames.push_back(new string(sbuf_name + std::to_string(sbuf_to_hash.pos0.offset)));
+            side_str += fuz_side_lines(sbuf_to_hash, *sdnames.back());
 
             // sdbf api: sdbf::sdbf(const char *name, char *str, uint32_t dd_block_size, uint64_t length, index_info *info)
-            // generates a new sdbf from a char *string           
-            sdbf *sdbf_block = new sdbf(sdnames.back()->c_str(), (char*)sbuf_to_hash.buf, fuz_block_size, sbuf_to_hash.bufsize, NULL);
+            // generates a new sdbf from a char *string and adds its features to the index of info
+            std::unique_lock<std::mutex> index_lock(sdhash_index_mutex, std::defer_lock);
+            if (sdhash_info != NULL) index_lock.lock();
+            sdbf *sdbf_block = new sdbf(sdnames.back()->c_str(), (char*)sbuf_to_hash.buf, fuz_block_size, sbuf_to_hash.bufsize, sdhash_info);
+            if (sdhash_info != NULL) index_lock.unlock();
             set1->add(sdbf_block);
         }
     } else {
@@ -725,6 +2084,7 @@ static void do_sdhash_import(const class scanner_params &sp, const recursion_con
             
             // sdbf name = filepath/filename + sbuf forensic path +  block sbuf offset
             sdnames.push_back(new string(sbuf_name + std::to_string(sbuf_to_hash.pos0.offset)));
+            side_str += fuz_side_lines(sbuf_to_hash, *sdnames.back());
 
             // sdbf api: sdbf::sdbf(const char *name, char *str, uint32_t dd_block_size, uint64_t length, index_info *info)
             // generates a new sdbf from a char *string
@@ -740,6 +2100,7 @@ static void do_sdhash_import(const class scanner_params &sp, const recursion_con
     
         //pop last endl to prevent writing blank lines to the output file
         std::string set1_str = set1->to_string();
+        set1_str += side_str;
         set1_str.erase(set1_str.end()-1);
         fuz_hashes_recorder->write(set1_str);
     }
@@ -774,6 +2135,10 @@ static void do_sdhash_scan(const class scanner_params &sp, const recursion_contr
     // create vector that stores pointers to the sdbf hash names
     std::vector <string *> sdnames;
     
+    // exact matches and simhashes of the blocks
+    fuz_exact_hits exact;
+    std::vector<uint64_t> simhashes;
+    
     if(fuz_sdhash_dd) {
         // iterate through the blocks of the sbuf and hash each block
         for (size_t offset=0; offset<sbuf.pagesize; offset+=fuz_step_size) {
@@ -790,9 +2155,21 @@ static void do_sdhash_scan(const class scanner_params &sp, const recursion_contr
             sdnames.push_back(new string(sbuf_name + std::to_string(sbuf_to_hash.pos0.offset)));
             
             // sdbf api: sdbf::sdbf(const char *name, char *str, uint32_t dd_block_size, uint64_t length, index_info *info)
-            // generates a new sdbf from a char *string
-            sdbf *sdbf_block = new sdbf(sdnames.back()->c_str(), (char*)sbuf_to_hash.buf, fuz_block_size, sbuf_to_hash.bufsize, NULL);
+            // generates a new sdbf from a char *string and looks up its features in the indexes of info
+            sdbf *sdbf_block = new sdbf(sdnames.back()->c_str(), (char*)sbuf_to_hash.buf, fuz_block_size, sbuf_to_hash.bufsize, sdhash_info);
+            
+            // the exact digest is computed once for the index check and the exact lookup
+            fuz_digest128 digest;
+            if (imported_exact != NULL) digest = fuz_exact_digest(sbuf_to_hash.buf, sbuf_to_hash.bufsize);
+            if (sdhash_info != NULL && fuz_sdhash_rejected(sdbf_block, digest)) {
+                delete sdbf_block;
+                delete sdnames.back();
+                sdnames.pop_back();
+                continue;
+            }
             set1->add(sdbf_block);
+            if (imported_exact != NULL) exact.find(*imported_exact, set1->size() - 1, digest, fuz_exact_skip, fuz_threshold);
+            if (imported_simhash != NULL) simhashes.push_back(fuz_simhash_signature(sbuf_to_hash.buf, sbuf_to_hash.bufsize));
         }
     } else {
         for (size_t offset=0; offset<sbuf.pagesize; offset+=fuz_step_size) {
@@ -811,24 +2188,53 @@ static void do_sdhash_scan(const class scanner_params &sp, const recursion_contr
             // sdbf api: sdbf::sdbf(const char *name, char *str, uint32_t dd_block_size, uint64_t length, index_info *info)
             // generates a new sdbf from a char *string
             sdbf *sdbf_block = new sdbf(sdnames.back()->c_str(), (char*)sbuf_to_hash.buf, 0, sbuf_to_hash.bufsize, NULL);
-            set1->add(sdbf_block);    
+            set1->add(sdbf_block);
+            if (imported_exact != NULL) {
+                exact.find(*imported_exact, set1->size() - 1, fuz_exact_digest(sbuf_to_hash.buf, sbuf_to_hash.bufsize),
+                           fuz_exact_skip, fuz_threshold);
+            }    
+            if (imported_simhash != NULL) simhashes.push_back(fuz_simhash_signature(sbuf_to_hash.buf, sbuf_to_hash.bufsize));
         }
     }
     
+    if (set1->empty()) {
+        delete set1;
+        return;
+    }
+    
     // compare sdbf sets and write scores to file
-    if(!set1->empty()) {
+    fuz_submit([=]() {
         set1->vector_init();
+
+        // the plugin scorer works on a flat copy of the query blocks, its indexes have to match the ones of set1
+        fuz_sdbf_store *store = NULL;
+        if (imported_sdhash_store != NULL) {
+            store = new fuz_sdbf_store();
+            for (uint32_t n = 0; n < set1->size(); n++) {
+                if (!store->add(set1->at(n)->to_string())) {
+                    std::cerr << "Error.  Cannot parse the sdhash-dd hash of block '" << set1->at(n)->name() << "'.\n"
+                              << "Cannot continue.\n";
+                    exit(1);
+                }
+            }
+        }
         
-        //std::string fuz_results = fuz_compare_two_sets(set1, set2, fuz_threshold, 0, false);
-        std::string fuz_results = fuz_compare_two_sets(set1, imported_sdhash, fuz_threshold, 0, false);
-        fuz_results.erase(fuz_results.end()-1);
-        fuz_scores_recorder->write(fuz_results);
-    }
+        //std::string fuz_results = fuz_compare_two_sets(set1, set2, NULL, fuz_threshold, 0, false);
+        exact_stats.matches += exact.matches.size();
+        exact_stats.skipped += std::count(exact.skip.begin(), exact.skip.end(), true);
+        std::string fuz_results = fuz_compare_two_sets(set1, imported_sdhash, imported_sdhash_lsh, imported_simhash, simhashes, exact,
+                                                       store, imported_sdhash_store, fuz_threshold, 0, false);
+        delete store;
+        if (!fuz_results.empty()) {
+            fuz_results.erase(fuz_results.end()-1);
+            fuz_scores_recorder->write(fuz_results);
+        }
 
-    // free allocations
-    for(auto &name : sdnames) delete name;   
-    for (uint32_t n=0; n<set1->size(); n++) delete set1->at(n);                       
-    delete set1;
+        // free allocations
+        for(auto &name : sdnames) delete name;   
+        for (uint32_t n=0; n<set1->size(); n++) delete set1->at(n);                       
+        delete set1;
+    });
 }
 
 // perform mrshv2 import
@@ -852,6 +2258,9 @@ static void do_mrshv2_import(const class scanner_params &sp, const recursion_con
     // create fingerprint list that stores all the block fingerprints
     FINGERPRINT_LIST *fpl = init_empty_fingerprintList();
     
+    // side signature lines of the blocks
+    std::string side_str;
+    
     // iterate through the blocks of the sbuf and hash each block
     for (size_t offset=0; offset<sbuf.pagesize; offset+=fuz_step_size) {    
         // create a child sbuf of what we would hash
@@ -873,6 +2282,7 @@ static void do_mrshv2_import(const class scanner_params &sp, const recursion_con
             fp_block_name = fp_block_name.erase(0, fp_block_name.length()-200);
         }
         strcpy(fp_block->file_name , fp_block_name.c_str());
+        side_str += fuz_side_lines(sbuf_to_hash, fp_block_name);
         fp_block->filesize = fuz_block_size;
         
         // mrshv2 hashing function for a (packet)buffer
@@ -886,6 +2296,7 @@ static void do_mrshv2_import(const class scanner_params &sp, const recursion_con
     // write hashes to file
     if (fpl->size != 0) {
         std::string fplist_str = fuz_fplist_to_string(fpl);
+        fplist_str += side_str;
         fplist_str.erase(fplist_str.end()-1);
         fuz_hashes_recorder->write(fplist_str);
     }
@@ -895,16 +2306,71 @@ static void do_mrshv2_import(const class scanner_params &sp, const recursion_con
 }
 
 // perform mrshv2 scan
+// compares query blocks with the imported mrshv2 fingerprints and writes the scores,
+// in presence mode the matches only count towards the coverage of the imported files
+static void fuz_compare_fp_batch(feature_recorder *fuz_scores_recorder, const fuz_fp_batch &batch)
+{
+    fuz_exact_hits exact;
+    if (imported_exact != NULL) {
+        for (size_t q = 0; q < batch.queries.size(); q++) {
+            exact.find(*imported_exact, q, batch.digests[q], fuz_exact_skip, fuz_threshold);
+        }
+    }
+    exact_stats.matches += exact.matches.size();
+    exact_stats.skipped += std::count(exact.skip.begin(), exact.skip.end(), true);
+    mrshv2_batches++;
+
+    std::vector<fuz_match> matches = fuz_match_two_fplists(*imported_mrshv2, imported_mrshv2_slices, imported_simhash,
+                                                           imported_mrshv2_successors, batch.queries, batch.simhashes, exact);
+    // mrshv2 only picks the candidates of a cascade, sdhash-dd scores them
+    if (imported_sdhash != NULL) {
+        matches = fuz_cascade_sdhash(imported_sdhash, cascade_refs, batch.queries, batch.contents, matches, fuz_threshold);
+    }
+    // exact matches are reported with score 100
+    matches = fuz_merge_exact(matches, exact);
+
+    // the best matches of the imported blocks are written at the end of the scan
+    if (mrshv2_topk_refs != NULL) {
+        mrshv2_topk_refs->add(matches, [&batch](uint32_t q) { return std::string(batch.queries.name(q)); });
+        return;
+    }
+    matches = fuz_topk_matches(matches, fuz_topk);
+
+    if (mrshv2_presence != NULL) {
+        std::vector<fuz_presence_hit> hits;
+        for (auto &match : matches) {
+            size_t length = 0;
+            uint64_t offset = 0;
+            fuz_block_offset(batch.queries.name(match.query), length, offset);
+            hits.push_back({match.ref, offset, batch.queries.name(match.query)});
+        }
+        mrshv2_presence->record(hits);
+        return;
+    }
+
+    // results are written grouped by query
+    std::stringstream out;
+    out.fill('0');
+    for (auto &match : matches) {
+        out << imported_mrshv2->name(match.ref) << fuz_sep << batch.queries.name(match.query) << fuz_sep << setw(3) << match.score << std::endl;
+    }
+    std::string fuz_results = out.str();
+    if (!fuz_results.empty()) {
+        fuz_results.erase(fuz_results.end()-1);
+        fuz_scores_recorder->write(fuz_results);
+    }
+}
+
 static void do_mrshv2_scan(const class scanner_params &sp, const recursion_control_block &rcb) 
 {
-    // get the feature recorder
-    feature_recorder* fuz_scores_recorder = sp.fs.get_name("fuz_scores");
+    // get the feature recorder, presence mode writes its report at shutdown
+    feature_recorder* fuz_scores_recorder = mrshv2_presence == NULL ? sp.fs.get_name("fuz_scores") : NULL;
     
     // create reference to the sbuf
     const sbuf_t& sbuf = sp.sbuf;
     
-    // create fingerprint list that stores all the block fingerprints
-    FINGERPRINT_LIST *fpl = init_empty_fingerprintList();
+    // fingerprints, exact digests and simhashes of the blocks
+    fuz_fp_batch *blocks = new fuz_fp_batch();
 
     // get first part of the hash name
     std::string sbuf_name;
@@ -928,33 +2394,48 @@ static void do_mrshv2_scan(const class scanner_params &sp, const recursion_contr
         
         // create empty fingerprint for the block
         FINGERPRINT *fp_block = init_empty_fingerprint();
-        
-        // mrshv2 only allows fingerprint names with a maximum of 200 characters including terminating null
-        // erase beginning of the string if name becomes too long (for the lack of a better solution for now)
-        std::string fp_block_name = sbuf_name + std::to_string(sbuf_to_hash.pos0.offset);
-        if (fp_block_name.length() > 200) {
-            fp_block_name = fp_block_name.erase(0, fp_block_name.length()-200);
-        }
-        strcpy(fp_block->file_name , fp_block_name.c_str());
         fp_block->filesize = fuz_block_size;
         
         // mrshv2 hashing function for a (packet)buffer
         // int hashPacketBuffer(FINGERPRINT *fingerprint, const unsigned char *packet, const size_t length)
         hashPacketBuffer(fp_block, (unsigned char *)sbuf_to_hash.buf, sbuf_to_hash.bufsize);
         
-        // add block fingerprint to fp list
-        add_new_fingerprint(fpl, fp_block);
+        // copy block fingerprint to the store, names are not limited to the 200 characters of mrshv2 here
+        blocks->queries.add(fp_block, sbuf_name + std::to_string(sbuf_to_hash.pos0.offset));
+        fingerprint_destroy(fp_block);
+        if (imported_exact != NULL) blocks->digests.push_back(fuz_exact_digest(sbuf_to_hash.buf, sbuf_to_hash.bufsize));
+        if (imported_simhash != NULL) blocks->simhashes.push_back(fuz_simhash_signature(sbuf_to_hash.buf, sbuf_to_hash.bufsize));
+        if (imported_sdhash != NULL) blocks->contents.push_back(std::string((const char *)sbuf_to_hash.buf, sbuf_to_hash.bufsize));
     }
     
-    // compare fingerprint lists and write scores to file
-    if (fpl->size != 0) {
-        std::string fuz_results = fuz_compare_two_fplists(imported_mrshv2, fpl);
-        fuz_results.erase(fuz_results.end()-1);
-        fuz_scores_recorder->write(fuz_results);
+    // the blocks join the shared batch, the thread that fills it submits it while the others keep hashing
+    if (fuz_batch != 0) {
+        fuz_fp_batch *full = NULL;
+        {
+            std::lock_guard<std::mutex> lock(mrshv2_batch_mutex);
+            mrshv2_batch->queries.append(blocks->queries);
+            mrshv2_batch->digests.insert(mrshv2_batch->digests.end(), blocks->digests.begin(), blocks->digests.end());
+            mrshv2_batch->simhashes.insert(mrshv2_batch->simhashes.end(), blocks->simhashes.begin(), blocks->simhashes.end());
+            mrshv2_batch->contents.insert(mrshv2_batch->contents.end(), blocks->contents.begin(), blocks->contents.end());
+            if (mrshv2_batch->queries.size() >= fuz_batch) {
+                full = mrshv2_batch;
+                mrshv2_batch = new fuz_fp_batch();
+            }
+        }
+        delete blocks;
+        blocks = full;
     }
-
-    // free allocations
-    fingerprintList_destroy(fpl);
+    if (blocks == NULL) return;
+    if (blocks->queries.size() == 0) {
+        delete blocks;
+        return;
+    }
+    
+    // compare fingerprint lists and write scores to file
+    fuz_submit([=]() {
+        fuz_compare_fp_batch(fuz_scores_recorder, *blocks);
+        delete blocks;
+    });
 }
 
 // perform ssdeep import
@@ -978,6 +2459,9 @@ static void do_ssdeep_import(const class scanner_params &sp, const recursion_con
     // vector to store pointers to the ssdeep digests
     std::vector <ssdeep_digest *> ssdeep_list;
     
+    // side signature lines of the blocks
+    std::string side_str;
+    
     // iterate through the blocks of the sbuf and hash each block
     for (size_t offset=0; offset<sbuf.pagesize; offset+=fuz_step_size) {
         // create a child sbuf of what we would hash
@@ -994,11 +2478,13 @@ static void do_ssdeep_import(const class scanner_params &sp, const recursion_con
         sdg->name = sbuf_name + std::to_string(sbuf_to_hash.pos0.offset);
         fuzzy_hash_buf(sbuf_to_hash.buf, sbuf_to_hash.bufsize, sdg->hash);
         ssdeep_list.push_back(sdg);
+        side_str += fuz_side_lines(sbuf_to_hash, sdg->name);
     }
     
     // write ssdeep set to file
     if (!ssdeep_list.empty()) {
         std::string sdg_str = fuz_ssdeep_list_to_string(ssdeep_list);
+        sdg_str += side_str;
         sdg_str.erase(sdg_str.end()-1);
         fuz_hashes_recorder->write(sdg_str);
     }
@@ -1019,6 +2505,10 @@ static void do_ssdeep_scan(const class scanner_params &sp, const recursion_contr
     // vectors to store pointers to the ssdeep digests
     std::vector <ssdeep_digest *> ssdeep_list2;
     
+    // exact matches and simhashes of the blocks
+    fuz_exact_hits exact;
+    std::vector<uint64_t> simhashes;
+    
     // get first part of the hash name
     std::string sbuf_name;
     if (sbuf.pos0.isRecursive()) {
@@ -1043,16 +2533,144 @@ static void do_ssdeep_scan(const class scanner_params &sp, const recursion_contr
         ssdeep_digest *sdg = new ssdeep_digest;
         sdg->name = sbuf_name + std::to_string(sbuf_to_hash.pos0.offset);
         fuzzy_hash_buf(sbuf_to_hash.buf, sbuf_to_hash.bufsize, sdg->hash);
+        fuz_ssdeep_parse(sdg->hash, sdg->parsed);
         ssdeep_list2.push_back(sdg);
+        if (imported_exact != NULL) {
+            exact.find(*imported_exact, ssdeep_list2.size() - 1, fuz_exact_digest(sbuf_to_hash.buf, sbuf_to_hash.bufsize),
+                       fuz_exact_skip, fuz_threshold);
+        }
+        if (imported_simhash != NULL) simhashes.push_back(fuz_simhash_signature(sbuf_to_hash.buf, sbuf_to_hash.bufsize));
     }
     
+    if (ssdeep_list2.size() == 0) return;
+    
     // compare ssdeep sets and write results to file
-    if (ssdeep_list2.size() != 0) {
-        std::string fuz_results = fuz_compare_two_ssdeep_lists(imported_ssdeep, ssdeep_list2, fuz_threshold);
-        fuz_results.erase(fuz_results.end()-1);
-        fuz_scores_recorder->write(fuz_results);
+    fuz_submit([=]() {
+        exact_stats.matches += exact.matches.size();
+        exact_stats.skipped += std::count(exact.skip.begin(), exact.skip.end(), true);
+        std::string fuz_results = fuz_compare_two_ssdeep_lists(*imported_ssdeep, ssdeep_list2, imported_ssdeep_index, imported_simhash, simhashes,
+                                                               exact, fuz_threshold);
+        if (!fuz_results.empty()) {
+            fuz_results.erase(fuz_results.end()-1);
+            fuz_scores_recorder->write(fuz_results);
+        }
+        
+        // free allocations     
+        for(auto &sdg2 : ssdeep_list2) delete sdg2;
+    });
+}
+
+// perform mrshv2 chunk hash import
+static void do_chunks_import(const class scanner_params &sp, const recursion_control_block &rcb)
+{
+    // get the feature recorder
+    feature_recorder* fuz_hashes_recorder = sp.fs.get_name("fuz_hashes");
+    
+    // create reference to the sbuf
+    const sbuf_t& sbuf = sp.sbuf;
+    
+    // get first part of the hash name
+    std::string sbuf_name;
+    if (sbuf.pos0.isRecursive()) {
+        sbuf_name = sbuf.pos0.path;       
+        const size_t p = sbuf_name.find(sbuf_t::map_file_delimiter);
+        if (p != std::string::npos) sbuf_name.erase(p, sbuf_t::map_file_delimiter.length());
+        sbuf_name += "-";
+    } else sbuf_name = sp.fs.get_input_fname() + "-";
+    
+    // chunk hashes of the blocks
+    std::vector<fuz_chunk_block> blocks;
+    
+    // side signature lines of the blocks
+    std::string side_str;
+    
+    // iterate through the blocks of the sbuf and hash each block
+    for (size_t offset=0; offset<sbuf.pagesize; offset+=fuz_step_size) {
+        // create a child sbuf of what we would hash
+        const sbuf_t sbuf_to_hash(sbuf, offset, fuz_block_size);
+        
+        // ignore very small blocks < 512 bytes
+        if (sbuf_to_hash.bufsize < 512) continue;
+        
+        // ignore empty blocks
+        if (empty_sbuf(sbuf_to_hash)) continue;
+        
+        // keep the chunk hashes mrshv2 would add to its bloom filters
+        blocks.push_back(fuz_chunk_block());
+        blocks.back().name = sbuf_name + std::to_string(sbuf_to_hash.pos0.offset);
+        fuz_chunk_hashes(sbuf_to_hash.buf, sbuf_to_hash.bufsize, blocks.back().hashes);
+        side_str += fuz_side_lines(sbuf_to_hash, blocks.back().name);
+    }
+    
+    // write chunk hashes to file
+    if (!blocks.empty()) {
+        std::string chunks_str = fuz_chunk_list_to_string(blocks);
+        chunks_str += side_str;
+        chunks_str.erase(chunks_str.end()-1);
+        fuz_hashes_recorder->write(chunks_str);
+    }
+}
+
+// perform mrshv2 chunk hash scan
+static void do_chunks_scan(const class scanner_params &sp, const recursion_control_block &rcb)
+{
+    // get the feature recorder
+    feature_recorder* fuz_scores_recorder = sp.fs.get_name("fuz_scores");
+    
+    // create reference to the sbuf
+    const sbuf_t& sbuf = sp.sbuf;
+    
+    // chunk hashes of the blocks
+    std::vector<fuz_chunk_block> *blocks = new std::vector<fuz_chunk_block>();
+    
+    // exact matches and simhashes of the blocks
+    fuz_exact_hits exact;
+    std::vector<uint64_t> simhashes;
+    
+    // get first part of the hash name
+    std::string sbuf_name;
+    if (sbuf.pos0.isRecursive()) {
+        sbuf_name = sbuf.pos0.path;       
+        const size_t p = sbuf_name.find(sbuf_t::map_file_delimiter);
+        if (p != std::string::npos) sbuf_name.erase(p, sbuf_t::map_file_delimiter.length());
+        sbuf_name += "-";
+    } else sbuf_name = sp.fs.get_input_fname() + "-";
+    
+    // iterate through the blocks of the sbuf and hash each block
+    for (size_t offset=0; offset<sbuf.pagesize; offset+=fuz_step_size) {
+        // create a child sbuf of what we would hash
+        const sbuf_t sbuf_to_hash(sbuf, offset, fuz_block_size);
+        
+        // ignore very small blocks < 512 bytes
+        if (sbuf_to_hash.bufsize < 512) continue;
+        
+        // ignore empty blocks
+        if (empty_sbuf(sbuf_to_hash)) continue;
+        
+        blocks->push_back(fuz_chunk_block());
+        blocks->back().name = sbuf_name + std::to_string(sbuf_to_hash.pos0.offset);
+        fuz_chunk_hashes(sbuf_to_hash.buf, sbuf_to_hash.bufsize, blocks->back().hashes);
+        if (imported_exact != NULL) {
+            exact.find(*imported_exact, blocks->size() - 1, fuz_exact_digest(sbuf_to_hash.buf, sbuf_to_hash.bufsize),
+                       fuz_exact_skip, fuz_threshold);
+        }
+        if (imported_simhash != NULL) simhashes.push_back(fuz_simhash_signature(sbuf_to_hash.buf, sbuf_to_hash.bufsize));
+    }
+    
+    if (blocks->empty()) {
+        delete blocks;
+        return;
     }
     
-    // free allocations     
-    for(auto &sdg2 : ssdeep_list2) delete sdg2;
+    // compare the chunk hashes with the index and write results to file
+    fuz_submit([=]() {
+        exact_stats.matches += exact.matches.size();
+        exact_stats.skipped += std::count(exact.skip.begin(), exact.skip.end(), true);
+        std::string fuz_results = fuz_compare_chunks(*imported_chunks, imported_simhash, *blocks, simhashes, exact, fuz_threshold);
+        if (!fuz_results.empty()) {
+            fuz_results.erase(fuz_results.end()-1);
+            fuz_scores_recorder->write(fuz_results);
+        }
+        delete blocks;
+    });
 }